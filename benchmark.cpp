@@ -0,0 +1,344 @@
+/*
+	benchmarks of the engine's hot paths. results are appended to a CSV
+	file in the format of execution_times.csv (Configuration, Real
+	Time, User Time, System Time) with more columns after those.
+
+	the microbenchmarks time LegalMoves (the move generator that
+	replaced NeighborMoves), EnumerateLegalMoves, FlipDisks, MakeMove,
+	EvaluateBoard (counting disks, and with the seed pattern weights)
+	and GameIsOver over a fixed corpus: the positions of games played
+	out by a depth 2 search from every position CORPUS_PLIES plies from
+	the start.
+
+	the search benchmark runs NegamaxRoot, as a computer move does, on
+	every position of a recorded game (bench_game) and reports the
+	median, 95th percentile and longest move time and the nodes per
+	second. the runtimes fix their number of workers once per process,
+	so it is run once per worker count; make bench does that.
+
+	usage: benchmark [--workers=N] [--depth=N] [--game=FILE] [--repeat=N]
+	                 [--output=FILE] [--no-micro]
+	defaults: the runtime's workers, depth 9, bench_game, 10 repeats of
+	each microbenchmark, bench_times.csv
+*/
+
+#include <sys/resource.h>
+#include "includes.h"
+
+namespace engine {
+#define main engine_main
+#include "othello.cpp"
+#undef main
+}
+
+typedef unsigned long long ull;
+
+#define CORPUS_PLIES 6
+#define CORPUS_DEPTH 2
+#define MAX_GAME 128
+
+// real, user and system seconds
+typedef struct {
+    double real;
+    double user;
+    double sys;
+} Times;
+
+static Times TimesNow(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    Times t = { engine::Now(), ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6,
+                ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6 };
+    return t;
+}
+
+static Times TimesSince(const Times &start) {
+    Times now = TimesNow();
+    Times t = { now.real - start.real, now.user - start.user, now.sys - start.sys };
+    return t;
+}
+
+// seconds as time(1) prints them, which run_experiment.sh copies into execution_times.csv
+static void PrintTime(FILE *out, double seconds) {
+    int minutes = (int)(seconds / 60);
+    fprintf(out, ",%dm%.3fs", minutes, seconds - 60 * minutes);
+}
+
+static FILE *OpenResults(const char *path) {
+    FILE *out = fopen(path, "a");
+    if (!out) {
+        perror(path);
+        return 0;
+    }
+    if (ftell(out) == 0) {
+        fprintf(out, "Configuration,Real Time,User Time,System Time,Operations,ns per Operation,"
+                "P50 ms,P95 ms,Max ms,Nodes per Second\n");
+    }
+    return out;
+}
+
+/*
+	the corpus: every position CORPUS_PLIES from the start, played out
+	to the end of the game by a CORPUS_DEPTH search, with each position
+	on the way.
+*/
+static long MakeCorpus(engine::Opening **corpus) {
+    engine::Opening *openings;
+    long nopenings = engine::MakeOpenings(CORPUS_PLIES, &openings);
+    long n = 0, size = nopenings * 64;
+    engine::Opening *c = (engine::Opening *)malloc(size * sizeof(engine::Opening));
+    for (long i = 0; i < nopenings; i++) {
+        engine::Board b = openings[i].board;
+        int color = openings[i].color;
+        int passes = 0;
+        while (passes < 2 && n < size) {
+            c[n].board = b;
+            c[n++].color = color;
+            if (engine::LegalMoves(b.disks[color], b.disks[OTHERCOLOR(color)]) == 0) {
+                passes++;
+            } else {
+                engine::Search s;
+                engine::Move m;
+                engine::InitSearch(&s, 0, 0, 0);
+                engine::NegamaxRoot(b, color, CORPUS_DEPTH, &s, &m);
+                int sq = BOARD_BIT_INDEX(m.row, m.col);
+                engine::ApplyFlips(&b, color, sq, engine::FlipMask(sq, b.disks[color], b.disks[OTHERCOLOR(color)]));
+                passes = 0;
+            }
+            color = OTHERCOLOR(color);
+        }
+    }
+    free(openings);
+    *corpus = c;
+    return n;
+}
+
+// each microbenchmark goes over the corpus once, counting what it did in *ops, and returns a checksum
+typedef ull (*MicroBenchmark)(const engine::Opening *c, const engine::Position *p, long n, long *ops);
+
+static ull BenchLegalMoves(const engine::Opening *c, const engine::Position *, long n, long *ops) {
+    ull sum = 0;
+    for (long i = 0; i < n; i++) {
+        sum += engine::LegalMoves(c[i].board.disks[c[i].color], c[i].board.disks[OTHERCOLOR(c[i].color)]);
+    }
+    *ops = n;
+    return sum;
+}
+
+static ull BenchEnumerateLegalMoves(const engine::Opening *c, const engine::Position *, long n, long *ops) {
+    ull sum = 0;
+    for (long i = 0; i < n; i++) {
+        engine::Board legal;
+        sum += engine::EnumerateLegalMoves(c[i].board, c[i].color, &legal);
+    }
+    *ops = n;
+    return sum;
+}
+
+static ull BenchFlipDisks(const engine::Opening *c, const engine::Position *, long n, long *ops) {
+    ull sum = 0;
+    *ops = 0;
+    for (long i = 0; i < n; i++) {
+        ull moves = engine::LegalMoves(c[i].board.disks[c[i].color], c[i].board.disks[OTHERCOLOR(c[i].color)]);
+        for (; moves; moves &= moves - 1) {
+            int sq = __builtin_ctzll(moves);
+            engine::Board b = c[i].board;
+            engine::Move m = { 8 - sq / 8, 8 - sq % 8 };
+            sum += engine::FlipDisks(m, &b, c[i].color, 0, 1);
+            (*ops)++;
+        }
+    }
+    return sum;
+}
+
+static ull BenchMakeMove(const engine::Opening *c, const engine::Position *p, long n, long *ops) {
+    ull sum = 0;
+    *ops = 0;
+    for (long i = 0; i < n; i++) {
+        ull moves = engine::LegalMoves(c[i].board.disks[c[i].color], c[i].board.disks[OTHERCOLOR(c[i].color)]);
+        for (; moves; moves &= moves - 1) {
+            engine::Position child;
+            engine::MakeMove(&p[i], c[i].color, __builtin_ctzll(moves), &child);
+            sum += child.key;
+            (*ops)++;
+        }
+    }
+    return sum;
+}
+
+static ull BenchEvaluateBoard(const engine::Opening *c, const engine::Position *, long n, long *ops) {
+    ull sum = 0;
+    for (long i = 0; i < n; i++) sum += engine::EvaluateBoard(c[i].board, c[i].color, 0);
+    *ops = n;
+    return sum;
+}
+
+static const engine::EvalWeights *seed_weights;
+
+static ull BenchEvaluatePatterns(const engine::Opening *c, const engine::Position *, long n, long *ops) {
+    ull sum = 0;
+    for (long i = 0; i < n; i++) sum += engine::EvaluateBoard(c[i].board, c[i].color, seed_weights);
+    *ops = n;
+    return sum;
+}
+
+static ull BenchGameIsOver(const engine::Opening *c, const engine::Position *, long n, long *ops) {
+    ull sum = 0;
+    for (long i = 0; i < n; i++) sum += engine::GameIsOver(c[i].board);
+    *ops = n;
+    return sum;
+}
+
+static void RunMicroBenchmarks(FILE *out, int repeat) {
+    engine::Opening *corpus;
+    long n = MakeCorpus(&corpus);
+    engine::Position *positions = (engine::Position *)malloc(n * sizeof(engine::Position));
+    for (long i = 0; i < n; i++) engine::SetPosition(&positions[i], corpus[i].board);
+    printf("%ld corpus positions, %d repeats\n", n, repeat);
+
+    struct { const char *name; MicroBenchmark run; } benchmarks[] = {
+        { "LegalMoves",            BenchLegalMoves },
+        { "EnumerateLegalMoves",   BenchEnumerateLegalMoves },
+        { "FlipDisks",             BenchFlipDisks },
+        { "MakeMove",              BenchMakeMove },
+        { "EvaluateBoard/disks",   BenchEvaluateBoard },
+        { "EvaluateBoard/pattern", BenchEvaluatePatterns },
+        { "GameIsOver",            BenchGameIsOver },
+    };
+    for (size_t k = 0; k < sizeof(benchmarks)/sizeof(benchmarks[0]); k++) {
+        ull sum = 0;
+        long ops = 0, total = 0;
+        Times start = TimesNow();
+        for (int r = 0; r < repeat; r++) {
+            sum += benchmarks[k].run(corpus, positions, n, &ops);
+            total += ops;
+        }
+        Times t = TimesSince(start);
+        double ns = t.real * 1e9 / total;
+        printf("%-22s %12ld ops %8.2f ns/op  (checksum %llx)\n", benchmarks[k].name, total, ns, sum);
+        fprintf(out, "%s", benchmarks[k].name);
+        PrintTime(out, t.real);
+        PrintTime(out, t.user);
+        PrintTime(out, t.sys);
+        fprintf(out, ",%ld,%.2f,,,,\n", total, ns);
+    }
+    free(positions);
+    free(corpus);
+}
+
+static int CompareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// the p-th percentile of the n sorted values in v, by nearest rank
+static double Percentile(const double *v, int n, int p) {
+    int rank = (int)ceil(p / 100.0 * n);
+    return v[rank > 0 ? rank - 1 : 0];
+}
+
+// search every position of the game in path to depth, as computer moves
+static int RunSearchBenchmark(FILE *out, const char *path, int depth) {
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return 1;
+    }
+    engine::Board boards[MAX_GAME];
+    int colors[MAX_GAME];
+    int n = 0;
+    char line[256];
+    while (n < MAX_GAME && fgets(line, sizeof(line), in)) {
+        if (line[0] == '#' || !engine::ParsePosition(line, &boards[n], &colors[n])) continue;
+        if (engine::LegalMoves(boards[n].disks[colors[n]], boards[n].disks[OTHERCOLOR(colors[n])]) == 0) continue;
+        n++;
+    }
+    fclose(in);
+    if (n == 0) {
+        fprintf(stderr, "%s: no positions\n", path);
+        return 1;
+    }
+
+    double latency[MAX_GAME];
+    ull nodes = 0;
+    Times start = TimesNow();
+    for (int i = 0; i < n; i++) {
+        engine::Search s;
+        engine::Move m;
+        engine::ClearOrdering();
+        engine::InitSearch(&s, 0, 0, 0);
+        double t0 = engine::Now();
+        ParallelRun([&] { engine::NegamaxRoot(boards[i], colors[i], depth, &s, &m); });
+        latency[i] = engine::Now() - t0;
+        nodes += engine::SearchNodes(&s);
+    }
+    Times t = TimesSince(start);
+    qsort(latency, n, sizeof(double), CompareDoubles);
+
+    char name[64];
+    snprintf(name, sizeof(name), "NegamaxRoot d%d w%d", depth, engine::spawn_workers);
+    double p50 = Percentile(latency, n, 50), p95 = Percentile(latency, n, 95), max = latency[n - 1];
+    printf("%-22s %12d moves, p50 %.3f ms, p95 %.3f ms, max %.3f ms, %.0f nodes/s\n",
+           name, n, p50 * 1e3, p95 * 1e3, max * 1e3, nodes / t.real);
+    fprintf(out, "%s", name);
+    PrintTime(out, t.real);
+    PrintTime(out, t.user);
+    PrintTime(out, t.sys);
+    fprintf(out, ",%d,%.0f,%.3f,%.3f,%.3f,%.0f\n", n, t.real * 1e9 / n, p50 * 1e3, p95 * 1e3, max * 1e3,
+            nodes / t.real);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *workers = 0;
+    const char *game = "bench_game";
+    const char *output = "bench_times.csv";
+    int depth = 9, repeat = 10, micro = 1;
+
+    static struct option options[] = {
+        { "workers",  required_argument, 0, 'j' },
+        { "depth",    required_argument, 0, 'd' },
+        { "game",     required_argument, 0, 'g' },
+        { "repeat",   required_argument, 0, 'r' },
+        { "output",   required_argument, 0, 'o' },
+        { "no-micro", no_argument,       0, 'm' },
+        { 0, 0, 0, 0 }
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, 0)) != -1) {
+        switch (opt) {
+        case 'j': workers = optarg; break;
+        case 'd': depth = atoi(optarg); break;
+        case 'g': game = optarg; break;
+        case 'r': repeat = atoi(optarg); break;
+        case 'o': output = optarg; break;
+        case 'm': micro = 0; break;
+        default:
+            fprintf(stderr, "usage: %s [--workers=N] [--depth=N] [--game=FILE] [--repeat=N] "
+                    "[--output=FILE] [--no-micro]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (workers && !ParSetWorkers(workers)) {
+        fprintf(stderr, "%s: cannot use %s workers\n", argv[0], workers);
+        return 1;
+    }
+    engine::spawn_workers = ParWorkers();
+
+    engine::InitRays();
+    engine::SelectKernels("auto");
+    engine::InitPatterns(1);
+    engine::InitZobrist();
+    if (!engine::InitTT(64)) {
+        fprintf(stderr, "%s: cannot allocate the transposition table\n", argv[0]);
+        return 1;
+    }
+    seed_weights = engine::SeedEvalWeights();
+
+    FILE *out = OpenResults(output);
+    if (!out) return 1;
+    if (micro) RunMicroBenchmarks(out, repeat);
+    int status = RunSearchBenchmark(out, game, depth);
+    fclose(out);
+    return status;
+}
@@ -0,0 +1,220 @@
+/*
+	differential test of the move generator in othello.cpp against the
+	reference logic in originalothello.cpp (NeighborMoves, TryFlips and
+	FlipDisks).
+
+	it plays random games and, at every position, compares the legal
+	moves and the board after each of them as computed by every move
+	generation kernel the cpu supports and by the reference. MakeMove,
+	walked through each game, must keep the Zobrist key, disk counts and
+	pattern indices SetPosition recomputes from the board. then it
+	checks perft leaf counts from the start position against the golden
+	values in perft.golden: the serial and parallel perft of othello.cpp
+	up to one depth, and a perft built on the reference up to a
+	shallower one (it is much slower).
+
+	usage: difftest [games [depth [reference depth]]]
+	defaults: 1000 games, depth 9, reference depth 7
+*/
+
+#include "includes.h"
+
+namespace reference {
+#define main reference_main
+#include "originalothello.cpp"
+#undef main
+}
+
+// othello.cpp defines the same macros, some of them differently
+#undef BIT
+#undef X_BLACK
+#undef O_WHITE
+#undef OTHERCOLOR
+#undef BOARD_BIT_INDEX
+#undef BOARD_BIT
+#undef MOVE_TO_BOARD_BIT
+#undef ROW8
+#undef COL8
+#undef COL1
+#undef IS_MOVE_OFF_BOARD
+#undef IS_DIAGONAL_MOVE
+#undef MOVE_OFFSET_TO_BIT_OFFSET
+
+namespace engine {
+#define main engine_main
+#include "othello.cpp"
+#undef main
+}
+
+typedef unsigned long long ull;
+
+#define MAX_REPORTS 10
+
+static long mismatches = 0;
+
+static void Mismatch(const char *what, const char *kernel, const engine::Board &b, int color) {
+    if (++mismatches <= MAX_REPORTS) {
+        printf("%s differ (%s): X %016llx O %016llx, %c to move\n", what, kernel,
+               b.disks[X_BLACK], b.disks[O_WHITE], color == X_BLACK ? 'X' : 'O');
+    }
+}
+
+// the legal moves of color by the reference
+static ull ReferenceMoves(const engine::Board &b, int color) {
+    reference::Board rb = { { b.disks[X_BLACK], b.disks[O_WHITE] } };
+    reference::Board legal;
+    reference::EnumerateLegalMoves(rb, color, &legal);
+    return legal.disks[color];
+}
+
+// b after color plays sq, by the reference
+static engine::Board ReferencePlay(const engine::Board &b, int color, int sq) {
+    reference::Board rb = { { b.disks[X_BLACK], b.disks[O_WHITE] } };
+    reference::Move m = { 8 - sq / 8, 8 - sq % 8 };
+    reference::FlipDisks(m, &rb, color, 0, 1);
+    reference::PlaceOrFlip(m, &rb, color);
+    engine::Board after = { { rb.disks[X_BLACK], rb.disks[O_WHITE] } };
+    return after;
+}
+
+// whether p's key, disk counts and pattern indices are those SetPosition computes from its board
+static bool SamePosition(const engine::Position &p) {
+    engine::Position full;
+    engine::SetPosition(&full, p.board);
+    return p.key == full.key && p.count[X_BLACK] == full.count[X_BLACK] &&
+           p.count[O_WHITE] == full.count[O_WHITE] && p.empties == full.empties &&
+           memcmp(p.index, full.index, engine::ninstances * sizeof(p.index[0])) == 0;
+}
+
+// compare every supported kernel with the reference at one position
+static void ComparePosition(const engine::Board &b, int color) {
+    ull me = b.disks[color], opp = b.disks[OTHERCOLOR(color)];
+    ull moves = ReferenceMoves(b, color);
+    for (int k = 0; k < engine::nkernels; k++) {
+        const engine::MoveKernels *kernel = &engine::kernels[k];
+        if (!kernel->supported()) continue;
+        if (kernel->legal_moves(me, opp) != moves) Mismatch("legal moves", kernel->name, b, color);
+        for (ull m = moves; m; m &= m - 1) {
+            int sq = __builtin_ctzll(m);
+            engine::Board mine = b, theirs = ReferencePlay(b, color, sq);
+            engine::ApplyFlips(&mine, color, sq, kernel->flip_mask(sq, me, opp));
+            if (memcmp(&mine, &theirs, sizeof(mine)) != 0) Mismatch("boards after a move", kernel->name, b, color);
+        }
+    }
+
+    // and the search's own move, which keeps more state than the board
+    engine::Position p;
+    engine::SetPosition(&p, b);
+    for (ull m = moves; m; m &= m - 1) {
+        int sq = __builtin_ctzll(m);
+        engine::Position child;
+        engine::MakeMove(&p, color, sq, &child);
+        engine::Board theirs = ReferencePlay(b, color, sq);
+        if (memcmp(&child.board, &theirs, sizeof(theirs)) != 0) Mismatch("boards after MakeMove", "auto", b, color);
+        if (!SamePosition(child)) Mismatch("keys or pattern indices after MakeMove", "auto", b, color);
+    }
+    bool over = (moves | ReferenceMoves(b, OTHERCOLOR(color))) == 0;
+    if (engine::GameIsOver(b) != over) Mismatch("game over", "auto", b, color);
+}
+
+static long CompareGames(long ngames) {
+    ull seed = 0x5DEECE66DULL;
+    long positions = 0;
+    for (long g = 0; g < ngames; g++) {
+        engine::Board b = engine::start;
+        engine::Position p;   // b, by MakeMove from the start
+        engine::SetPosition(&p, b);
+        int color = X_BLACK, passes = 0;
+        while (passes < 2) {
+            ComparePosition(b, color);
+            if (memcmp(&p.board, &b, sizeof(b)) != 0 || !SamePosition(p)) {
+                Mismatch("positions kept by MakeMove", "auto", b, color);
+            }
+            positions++;
+            ull moves = ReferenceMoves(b, color);
+            if (moves == 0) {
+                passes++;
+            } else {
+                int n = engine::NextRandom(&seed) % __builtin_popcountll(moves);
+                while (n--) moves &= moves - 1;
+                int sq = __builtin_ctzll(moves);
+                b = ReferencePlay(b, color, sq);
+                engine::Position next;
+                engine::MakeMove(&p, color, sq, &next);
+                p = next;
+                passes = 0;
+            }
+            color = OTHERCOLOR(color);
+        }
+    }
+    return positions;
+}
+
+// engine::Perft on the reference move generator
+static ull ReferencePerft(const engine::Board &b, int color, int depth) {
+    if (depth == 0) return 1;
+    ull moves = ReferenceMoves(b, color);
+    if (moves == 0) {
+        if (ReferenceMoves(b, OTHERCOLOR(color)) == 0) return 1;   // game over
+        return ReferencePerft(b, OTHERCOLOR(color), depth - 1);
+    }
+    if (depth == 1) return __builtin_popcountll(moves);
+    ull leaves = 0;
+    for (; moves; moves &= moves - 1) {
+        leaves += ReferencePerft(ReferencePlay(b, color, __builtin_ctzll(moves)), OTHERCOLOR(color), depth - 1);
+    }
+    return leaves;
+}
+
+// check perft from the start position against the golden counts
+static int CheckPerft(const char *path, int maxdepth, int refdepth) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    char line[256];
+    int errors = 0, checked = 0;
+    while (fgets(line, sizeof(line), f)) {
+        int depth;
+        ull golden;
+        if (line[0] == '#' || sscanf(line, "%d %llu", &depth, &golden) != 2) continue;
+        if (depth > maxdepth) continue;
+        ull serial = engine::Perft(engine::start, X_BLACK, depth);
+        ull parallel = engine::PerftParallel(engine::start, X_BLACK, depth);
+        printf("perft %2d: %llu", depth, golden);
+        if (serial != golden) printf(", serial %llu", serial);
+        if (parallel != golden) printf(", parallel %llu", parallel);
+        errors += (serial != golden) + (parallel != golden);
+        if (depth <= refdepth) {
+            ull ref = ReferencePerft(engine::start, X_BLACK, depth);
+            if (ref != golden) printf(", reference %llu", ref);
+            errors += (ref != golden);
+        }
+        printf("%s\n", (serial == golden && parallel == golden) ? " ok" : " MISMATCH");
+        checked++;
+    }
+    fclose(f);
+    if (checked == 0) {
+        fprintf(stderr, "%s: no perft counts to check\n", path);
+        return 1;
+    }
+    return errors;
+}
+
+int main(int argc, char **argv) {
+    long ngames = (argc > 1) ? atol(argv[1]) : 1000;
+    int depth = (argc > 2) ? atoi(argv[2]) : 9;
+    int refdepth = (argc > 3) ? atoi(argv[3]) : 7;
+
+    engine::InitRays();
+    engine::SelectKernels("auto");
+    engine::InitZobrist();
+    engine::InitPatterns(1);
+    engine::track_patterns = 1;
+
+    long positions = CompareGames(ngames);
+    printf("%ld games, %ld positions, %ld mismatches\n", ngames, positions, mismatches);
+    int perfterrors = CheckPerft("perft.golden", depth, refdepth);
+    return (mismatches || perfterrors) ? 1 : 0;
+}
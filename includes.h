@@ -0,0 +1,30 @@
+/*
+	the headers othello.cpp uses. difftest.cpp and benchmark.cpp include
+	othello.cpp inside a namespace, so they include these first: the
+	include guards then keep the system's declarations out of it.
+*/
+
+#ifndef INCLUDES_H
+#define INCLUDES_H
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <getopt.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "parallel.h"
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
+
+#endif
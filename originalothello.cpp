@@ -286,3 +286,4 @@ int main (int argc, const char * argv[])
 	
   return 0;
 
+}
@@ -1,10 +1,4 @@
-#include <cstdio>
-#include <cstdlib>
-#include <cilk/cilk.h>
-#include <cilk/reducer_max.h>
-
-// Define a cutoff depth for switching to serial execution
-#define CUTOFF_DEPTH 4
+#include "includes.h"
 
 #define BIT 0x1
 
@@ -35,6 +29,9 @@
 /* all of the bits in column 1 */
 #define COL1 (COL8 << 7)
 
+/* all of the bits not in column 1 or column 8 */
+#define INNER_COLS (~(COL1 | COL8))
+
 #define IS_MOVE_OFF_BOARD(m) ( (m.row < 1) || (m.row > 8) || (m.col < 1) || (m.col > 8) )
 #define IS_DIAGONAL_MOVE(m) ( (m.row != 0) && (m.col != 0) )
 #define MOVE_OFFSET_TO_BIT_OFFSET(m) ( (m.row * 8) + (m.col) )
@@ -155,6 +152,339 @@ int FlipDisks(Move m, Board *b, int color, int verbose, int domove) {
 }
 
 
+/*
+	rays[sq][i] is the set of squares reached by stepping from square
+	sq along one of the 8 directions in offsets[] until falling off the
+	board. rays 0..3 run toward higher bit indices (the nearest square
+	is the lowest bit), rays 4..7 toward lower bit indices (the nearest
+	square is the highest bit).
+*/
+static ull rays[64][8] __attribute__((aligned(64)));
+
+static void InitRays(void) {
+    for (int sq = 0; sq < 64; sq++) {
+        int up = 0, down = 4;
+        for (int i = 0; i < noffsets; i++) {
+            Move m = { 8 - (sq / 8), 8 - (sq % 8) };
+            ull ray = 0ULL;
+            for (;;) {
+                m.row += offsets[i].row;
+                m.col += offsets[i].col;
+                if (IS_MOVE_OFF_BOARD(m)) break;
+                ray |= MOVE_TO_BOARD_BIT(m);
+            }
+            if (MOVE_OFFSET_TO_BIT_OFFSET(offsets[i]) < 0) {
+                rays[sq][up++] = ray;
+            } else {
+                rays[sq][down++] = ray;
+            }
+        }
+    }
+}
+
+/*
+	return the set of opponent disks flipped by a disk placed on square
+	sq. along each ray, the first square that does not hold an opponent
+	disk is the outflanking square; the opponent disks before it flip
+	if and only if that square holds one of my disks. no branches, no
+	recursion: each ray costs a bit isolate and a few masks.
+*/
+static ull FlipMaskScalar(int sq, ull me, ull opp) {
+    const ull *ray = rays[sq];
+    ull flips = 0ULL;
+    for (int i = 0; i < 4; i++) {
+        ull outflank = ray[i] & ~opp;
+        outflank &= -outflank;
+        flips |= ray[i] & (outflank - 1) & -(ull)((outflank & me) != 0);
+    }
+    for (int i = 4; i < 8; i++) {
+        ull outflank = 0x8000000000000000ULL >> __builtin_clzll((ray[i] & ~opp) | 1);
+        flips |= ray[i] & -(outflank << 1) & -(ull)((outflank & ray[i] & me) != 0);
+    }
+    return flips;
+}
+
+/* place a disk of color on square sq and flip the disks in flips */
+static inline void ApplyFlips(Board *b, int color, int sq, ull flips) {
+    b->disks[color] ^= flips | (0x1ULL << sq);
+    b->disks[OTHERCOLOR(color)] ^= flips;
+}
+
+
+/*
+	grow runs of disks in mask outward from the disks in me, in both
+	directions along one line (shift 1: row, 8: column, 7 and 9:
+	diagonals). a run between two of my disks is at most 6 long, so
+	one shift plus five fills reaches every square that can end a run.
+	the return value is the set of squares just past the end of a run.
+*/
+static inline ull LegalMovesAlong(ull me, ull mask, int shift) {
+    ull up = mask & (me << shift);
+    ull down = mask & (me >> shift);
+    up |= mask & (up << shift);
+    down |= mask & (down >> shift);
+    up |= mask & (up << shift);
+    down |= mask & (down >> shift);
+    up |= mask & (up << shift);
+    down |= mask & (down >> shift);
+    up |= mask & (up << shift);
+    down |= mask & (down >> shift);
+    up |= mask & (up << shift);
+    down |= mask & (down >> shift);
+    return (up << shift) | (down >> shift);
+}
+
+/*
+	return the set of legal moves for the player owning the disks in
+	me: the empty squares at the end of a run of opponent disks that
+	starts at one of my disks. all 8 directions are done at once on the
+	whole board. opponent disks in columns 1 and 8 are masked off for
+	every direction with a column component so runs cannot wrap
+	around the edge of the board.
+*/
+static ull LegalMovesScalar(ull me, ull opp) {
+    ull inner = opp & INNER_COLS;
+    ull moves = LegalMovesAlong(me, inner, 1)
+              | LegalMovesAlong(me, opp, 8)
+              | LegalMovesAlong(me, inner, 7)
+              | LegalMovesAlong(me, inner, 9);
+    return moves & ~(me | opp);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/*
+	AVX2 kernels. the four line directions (shifts 1, 8, 7 and 9) sit
+	in the four 64-bit lanes of one register; the two directions along
+	each line are done with a left and a right variable shift.
+*/
+
+__attribute__((target("avx2")))
+static ull LegalMovesAVX2(ull me, ull opp) {
+    const __m256i shift = _mm256_set_epi64x(9, 7, 8, 1);
+    const __m256i mask = _mm256_and_si256(_mm256_set1_epi64x(opp),
+        _mm256_set_epi64x(INNER_COLS, INNER_COLS, ~0ULL, INNER_COLS));
+    const __m256i mine = _mm256_set1_epi64x(me);
+    __m256i up = _mm256_and_si256(mask, _mm256_sllv_epi64(mine, shift));
+    __m256i down = _mm256_and_si256(mask, _mm256_srlv_epi64(mine, shift));
+    for (int i = 0; i < 5; i++) {
+        up = _mm256_or_si256(up, _mm256_and_si256(mask, _mm256_sllv_epi64(up, shift)));
+        down = _mm256_or_si256(down, _mm256_and_si256(mask, _mm256_srlv_epi64(down, shift)));
+    }
+    __m256i moves = _mm256_or_si256(_mm256_sllv_epi64(up, shift), _mm256_srlv_epi64(down, shift));
+    __m128i m = _mm_or_si128(_mm256_castsi256_si128(moves), _mm256_extracti128_si256(moves, 1));
+    m = _mm_or_si128(m, _mm_unpackhi_epi64(m, m));
+    return (ull)_mm_cvtsi128_si64(m) & ~(me | opp);
+}
+
+/*
+	rays 0..3 in one register, rays 4..7 in another. AVX2 has no
+	per-lane leading zero count, so the highest blocker on the
+	downward rays is found by smearing the blockers toward bit 0.
+*/
+__attribute__((target("avx2")))
+static ull FlipMaskAVX2(int sq, ull me, ull opp) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i mine = _mm256_set1_epi64x(me);
+    const __m256i theirs = _mm256_set1_epi64x(opp);
+
+    __m256i ray = _mm256_load_si256((const __m256i *)&rays[sq][0]);
+    __m256i outflank = _mm256_andnot_si256(theirs, ray);
+    outflank = _mm256_and_si256(outflank, _mm256_sub_epi64(zero, outflank));
+    __m256i up = _mm256_and_si256(ray, _mm256_sub_epi64(outflank, one));
+    up = _mm256_andnot_si256(_mm256_cmpeq_epi64(_mm256_and_si256(outflank, mine), zero), up);
+
+    ray = _mm256_load_si256((const __m256i *)&rays[sq][4]);
+    __m256i below = _mm256_andnot_si256(theirs, ray);
+    below = _mm256_or_si256(below, _mm256_srli_epi64(below, 1));
+    below = _mm256_or_si256(below, _mm256_srli_epi64(below, 2));
+    below = _mm256_or_si256(below, _mm256_srli_epi64(below, 4));
+    below = _mm256_or_si256(below, _mm256_srli_epi64(below, 8));
+    below = _mm256_or_si256(below, _mm256_srli_epi64(below, 16));
+    below = _mm256_or_si256(below, _mm256_srli_epi64(below, 32));
+    outflank = _mm256_andnot_si256(_mm256_srli_epi64(below, 1), below);
+    __m256i down = _mm256_andnot_si256(below, ray);
+    down = _mm256_andnot_si256(_mm256_cmpeq_epi64(_mm256_and_si256(outflank, mine), zero), down);
+
+    __m256i flips = _mm256_or_si256(up, down);
+    __m128i f = _mm_or_si128(_mm256_castsi256_si128(flips), _mm256_extracti128_si256(flips, 1));
+    f = _mm_or_si128(f, _mm_unpackhi_epi64(f, f));
+    return (ull)_mm_cvtsi128_si64(f);
+}
+
+/*
+	AVX-512 kernels: all 8 directions in one 512-bit register. lanes
+	0..3 shift left and lanes 4..7 shift right; a shift count of 64
+	clears a lane, so one sllv and one srlv cover both halves.
+*/
+
+__attribute__((target("avx512f")))
+static ull LegalMovesAVX512(ull me, ull opp) {
+    const __m512i left = _mm512_set_epi64(64, 64, 64, 64, 9, 7, 8, 1);
+    const __m512i right = _mm512_set_epi64(9, 7, 8, 1, 64, 64, 64, 64);
+    const __m512i mask = _mm512_and_si512(_mm512_set1_epi64(opp),
+        _mm512_set_epi64(INNER_COLS, INNER_COLS, ~0ULL, INNER_COLS,
+                         INNER_COLS, INNER_COLS, ~0ULL, INNER_COLS));
+    const __m512i mine = _mm512_set1_epi64(me);
+    __m512i run = _mm512_and_si512(mask,
+        _mm512_or_si512(_mm512_sllv_epi64(mine, left), _mm512_srlv_epi64(mine, right)));
+    for (int i = 0; i < 5; i++) {
+        run = _mm512_or_si512(run, _mm512_and_si512(mask,
+            _mm512_or_si512(_mm512_sllv_epi64(run, left), _mm512_srlv_epi64(run, right))));
+    }
+    __m512i moves = _mm512_or_si512(_mm512_sllv_epi64(run, left), _mm512_srlv_epi64(run, right));
+    return (ull)_mm512_reduce_or_epi64(moves) & ~(me | opp);
+}
+
+/*
+	the 8 rays of sq are one aligned 64-byte load. upward rays take
+	the lowest blocker, downward rays the highest via a per-lane
+	leading zero count (AVX512CD); a count of 64 yields no outflank.
+*/
+__attribute__((target("avx512f,avx512cd")))
+static ull FlipMaskAVX512(int sq, ull me, ull opp) {
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i one = _mm512_set1_epi64(1);
+    __m512i ray = _mm512_load_si512((const void *)rays[sq]);
+    __m512i blockers = _mm512_andnot_si512(_mm512_set1_epi64(opp), ray);
+    __m512i lowest = _mm512_and_si512(blockers, _mm512_sub_epi64(zero, blockers));
+    __m512i highest = _mm512_srlv_epi64(_mm512_set1_epi64(0x8000000000000000ULL),
+                                        _mm512_lzcnt_epi64(blockers));
+    __m512i outflank = _mm512_mask_blend_epi64(0xF0, lowest, highest);
+    __m512i up = _mm512_and_si512(ray, _mm512_sub_epi64(outflank, one));
+    __m512i down = _mm512_and_si512(ray, _mm512_sub_epi64(zero, _mm512_slli_epi64(outflank, 1)));
+    __m512i flips = _mm512_mask_blend_epi64(0xF0, up, down);
+    __mmask8 outflanked = _mm512_test_epi64_mask(outflank, _mm512_set1_epi64(me));
+    return (ull)_mm512_mask_reduce_or_epi64(outflanked, flips);
+}
+
+static int HaveAVX2(void) {
+    return __builtin_cpu_supports("avx2");
+}
+
+static int HaveAVX512(void) {
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512cd");
+}
+
+#endif
+
+static int HaveScalar(void) {
+    return 1;
+}
+
+/*
+	move generation kernels, best first. the engine calls through
+	legal_moves_kernel and flip_mask_kernel, which SelectKernels points
+	at the best kernel the cpu supports (or the one asked for).
+*/
+typedef struct {
+    const char *name;
+    int (*supported)(void);
+    ull (*legal_moves)(ull me, ull opp);
+    ull (*flip_mask)(int sq, ull me, ull opp);
+} MoveKernels;
+
+static MoveKernels kernels[] = {
+#if defined(__x86_64__) || defined(__i386__)
+    { "avx512", HaveAVX512, LegalMovesAVX512, FlipMaskAVX512 },
+    { "avx2",   HaveAVX2,   LegalMovesAVX2,   FlipMaskAVX2 },
+#endif
+    { "scalar", HaveScalar, LegalMovesScalar, FlipMaskScalar }
+};
+
+static int nkernels = sizeof(kernels)/sizeof(MoveKernels);
+
+static ull (*legal_moves_kernel)(ull me, ull opp) = LegalMovesScalar;
+static ull (*flip_mask_kernel)(int sq, ull me, ull opp) = FlipMaskScalar;
+
+static inline ull LegalMoves(ull me, ull opp) {
+    return legal_moves_kernel(me, opp);
+}
+
+static inline ull FlipMask(int sq, ull me, ull opp) {
+    return flip_mask_kernel(sq, me, opp);
+}
+
+/*
+	select the kernels named by name ("auto" picks the best one the cpu
+	supports). returns the selected kernel set, or 0 if name is unknown
+	or not supported on this cpu.
+*/
+static const MoveKernels *SelectKernels(const char *name) {
+    __builtin_cpu_init();
+    for (int i = 0; i < nkernels; i++) {
+        if (strcmp(name, "auto") != 0 && strcmp(name, kernels[i].name) != 0) continue;
+        if (!kernels[i].supported()) continue;
+        legal_moves_kernel = kernels[i].legal_moves;
+        flip_mask_kernel = kernels[i].flip_mask;
+        return &kernels[i];
+    }
+    return 0;
+}
+
+/* xorshift64 step; state must not be 0 */
+static inline ull NextRandom(ull *state) {
+    ull x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+/*
+	play ngames random games with the scalar kernels and, at every
+	position, compare the legal moves and the flips of every legal
+	move computed by each supported kernel. returns the number of
+	mismatches.
+*/
+static long CheckKernels(long ngames) {
+    ull seed = 0x9E3779B97F4A7C15ULL;
+    long positions = 0, errors = 0;
+    for (long g = 0; g < ngames; g++) {
+        Board b = start;
+        int color = X_BLACK, passes = 0;
+        while (passes < 2) {
+            ull me = b.disks[color], opp = b.disks[OTHERCOLOR(color)];
+            ull moves = LegalMovesScalar(me, opp);
+            positions++;
+            for (int k = 0; k < nkernels; k++) {
+                if (!kernels[k].supported()) continue;
+                if (kernels[k].legal_moves(me, opp) != moves) {
+                    printf("%s: legal moves differ for %016llx %016llx\n",
+                           kernels[k].name, me, opp);
+                    errors++;
+                }
+                for (ull m = moves; m; m &= m - 1) {
+                    int sq = __builtin_ctzll(m);
+                    if (kernels[k].flip_mask(sq, me, opp) != FlipMaskScalar(sq, me, opp)) {
+                        printf("%s: flips differ at square %d for %016llx %016llx\n",
+                               kernels[k].name, sq, me, opp);
+                        errors++;
+                    }
+                }
+            }
+            if (moves == 0) {
+                passes++;
+            } else {
+                int n = NextRandom(&seed) % __builtin_popcountll(moves);
+                while (n--) moves &= moves - 1;
+                int sq = __builtin_ctzll(moves);
+                ApplyFlips(&b, color, sq, FlipMaskScalar(sq, me, opp));
+                passes = 0;
+            }
+            color = OTHERCOLOR(color);
+        }
+    }
+    for (int k = 0; k < nkernels; k++) {
+        printf("%-6s %s\n", kernels[k].name,
+               kernels[k].supported() ? "checked" : "not supported on this cpu");
+    }
+    printf("%ld positions, %ld mismatches\n", positions, errors);
+    return errors;
+}
+
+
 void ReadMove(int color, Board *b) {
     Move m;
     ull movebit;
@@ -209,49 +539,10 @@ int HumanTurn(Board *b, int color) {
     return 0; // pass
 }
 
-/*
-	return the set of board positions adjacent to an opponent's
-	disk that are empty. these represent a candidate set of 
-	positions for a move by color.
-*/
-
-static Board NeighborMoves(Board b, int color) {
-    Board neighbors = {0ULL, 0ULL};
-    for (int i = 0; i < noffsets; i++) {
-        ull colmask = (offsets[i].col != 0)
-                        ? ((offsets[i].col > 0) ? COL1 : COL8)
-                        : 0ULL;
-        int off = MOVE_OFFSET_TO_BIT_OFFSET(offsets[i]);
-
-        if (off > 0) {
-            neighbors.disks[color] |= (b.disks[OTHERCOLOR(color)] >> off) & ~colmask;
-        } else {
-            neighbors.disks[color] |= (b.disks[OTHERCOLOR(color)] << -off) & ~colmask;
-        }
-    }
-    neighbors.disks[color] &= ~(b.disks[X_BLACK] | b.disks[O_WHITE]);
-    return neighbors;
-}
-
 int EnumerateLegalMoves(Board b, int color, Board *legal_moves) {
-    legal_moves->disks[color] = 0ULL;
-    Board neighbors = NeighborMoves(b, color);
-    ull my_neighbor_moves = neighbors.disks[color];
-    int num_moves = 0;
-
-    while (my_neighbor_moves) {
-        ull next_move = my_neighbor_moves & -my_neighbor_moves;
-        int bitpos = __builtin_ctzll(next_move);
-        int row = 8 - (bitpos / 8);
-        int col = 8 - (bitpos % 8);
-        Move m = { row, col };
-        if (FlipDisks(m, &b, color, 0, 0) > 0) {
-            legal_moves->disks[color] |= next_move;
-            num_moves++;
-        }
-        my_neighbor_moves ^= next_move;
-    }
-    return num_moves;
+    ull moves = LegalMoves(b.disks[color], b.disks[OTHERCOLOR(color)]);
+    legal_moves->disks[color] = moves;
+    return __builtin_popcountll(moves);
 }
 
 
@@ -280,14 +571,12 @@ void EndGame(Board b) {
 
 // Check if neither side can move
 bool GameIsOver(const Board &b) {
-    Board dummy;
-    int xMoves = EnumerateLegalMoves(b, X_BLACK, &dummy);
-    int oMoves = EnumerateLegalMoves(b, O_WHITE, &dummy);
-    return (xMoves == 0 && oMoves == 0);
+    return (LegalMoves(b.disks[X_BLACK], b.disks[O_WHITE]) |
+            LegalMoves(b.disks[O_WHITE], b.disks[X_BLACK])) == 0;
 }
 
-// Evaluate the board
-int EvaluateBoard(const Board &b, int color) {
+// Evaluate the board by the disk difference (also the final score of a game)
+int DiskDifference(const Board &b, int color) {
     int myCount  = CountBitsOnBoard(&b, color);
     int oppCount = CountBitsOnBoard(&b, OTHERCOLOR(color));
     // If color==X_BLACK => score = myCount - oppCount
@@ -295,198 +584,4116 @@ int EvaluateBoard(const Board &b, int color) {
     return (myCount - oppCount);
 }
 
-// Copy oldBoard
-static int MakeMove(const Board *oldBoard, int color, Move m, Board *newBoard) {
-    *newBoard = *oldBoard;  
-    int flipped = FlipDisks(m, newBoard, color, 0, 1);
-    PlaceOrFlip(m, newBoard, color);
-    return flipped;
+/*
+	pattern evaluation. the board is cut into shapes (edges, corners,
+	diagonals, 2x5 corner blocks); every placement of a shape on the
+	board is an instance, and the disks on an instance's squares form a
+	base 3 index (0 empty, 1 X, 2 O) into a weight table shared by all
+	instances of the shape. mobility, potential
+	mobility (empty squares next to the opponent's disks) and parity
+	add small tables of their own. each game phase (by number of disks)
+	has its own set of tables.
+
+	instances are read off with one mask per shape: the board is
+	mirrored, flipped or transposed so the instance lands on the shape's
+	squares, and the bits under the mask are gathered with PEXT (or a
+	bit loop on cpus without BMI2). the gathered bits are in ascending
+	square order, and that order defines the digits of the index.
+
+	weights are 16-bit, in 1/EVAL_UNIT of a disk, for the player to
+	move (digit 1 mine, 2 the opponent's), and come from a file loaded
+	with --eval (format at LoadEvalWeights). a copy with 1 and 2
+	swapped serves O. each player can have weights of its own; a
+	player without weights keeps counting disks.
+*/
+
+#define EVAL_UNIT 128
+#define EVAL_MAX 63       // pattern scores stay inside the final score range
+#define MAX_SHAPE_SQUARES 10
+
+typedef struct {
+    const char *name;
+    int nsquares;
+    Move squares[MAX_SHAPE_SQUARES];
+} PatternShape;
+
+static const PatternShape shapes[] = {
+    { "corner3x3", 9, { {1,1}, {1,2}, {1,3}, {2,1}, {2,2}, {2,3}, {3,1}, {3,2}, {3,3} } },
+    { "corner2x5", 10, { {1,1}, {1,2}, {1,3}, {1,4}, {1,5}, {2,1}, {2,2}, {2,3}, {2,4}, {2,5} } },
+    { "edge2x",    10, { {1,1}, {1,2}, {1,3}, {1,4}, {1,5}, {1,6}, {1,7}, {1,8}, {2,2}, {2,7} } },
+    { "diag8",     8, { {1,1}, {2,2}, {3,3}, {4,4}, {5,5}, {6,6}, {7,7}, {8,8} } },
+    { "diag7",     7, { {1,2}, {2,3}, {3,4}, {4,5}, {5,6}, {6,7}, {7,8} } },
+    { "diag6",     6, { {1,3}, {2,4}, {3,5}, {4,6}, {5,7}, {6,8} } },
+    { "diag5",     5, { {1,4}, {2,5}, {3,6}, {4,7}, {5,8} } },
+    { "diag4",     4, { {1,5}, {2,6}, {3,7}, {4,8} } }
+};
+
+#define NSHAPES ((int)(sizeof(shapes)/sizeof(PatternShape)))
+#define MAX_INSTANCES 36   // 34 with these shapes
+
+/*
+	weight tables of one phase, in file order: one per shape, then
+	mobility and potential mobility (by count, for each side) and
+	parity (by number of empties mod 2).
+*/
+#define EVAL_MOBILITY      (NSHAPES)
+#define EVAL_OPP_MOBILITY  (NSHAPES + 1)
+#define EVAL_POTENTIAL     (NSHAPES + 2)
+#define EVAL_OPP_POTENTIAL (NSHAPES + 3)
+#define EVAL_PARITY        (NSHAPES + 4)
+#define EVAL_TABLES        (NSHAPES + 5)
+
+typedef struct {
+    int shape;
+    int sym;                          // transform applied before extraction
+    int squares[MAX_SHAPE_SQUARES];   // board square of each digit, lowest first
+} PatternInstance;
+
+static ull shape_mask[NSHAPES];
+static PatternInstance instances[MAX_INSTANCES];
+static int ninstances = 0;
+static int base3[1 << MAX_SHAPE_SQUARES];     // binary digits read in base 3
+static int pow3[MAX_SHAPE_SQUARES + 1];
+
+static int table_size[EVAL_TABLES];
+static int table_offset[EVAL_TABLES];
+static int phase_size = 0;
+
+typedef struct {
+    const char *name;   // where the weights came from
+    short *tables[2];   // phases * phase_size weights with X (O) to move
+    int phases;
+    ull salt;           // mixed into table keys so evaluations don't share entries
+} EvalWeights;
+
+// Positions keep pattern indices once any weights are in use
+static int track_patterns = 0;
+
+// the digits each square contributes to, to update indices incrementally
+#define MAX_SQUARE_DIGITS 16
+typedef struct { unsigned short instance; unsigned short power; } PatternDigit;
+static PatternDigit square_digits[64][MAX_SQUARE_DIGITS];
+static int nsquare_digits[64];
+
+static inline ull FlipVertical(ull x) {
+    return __builtin_bswap64(x);
+}
+
+static inline ull MirrorHorizontal(ull x) {
+    x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    return x;
 }
 
+// swap row and column
+static inline ull Transpose(ull x) {
+    ull t;
+    t = 0x0F0F0F0F00000000ULL & (x ^ (x << 28));
+    x ^= t ^ (t >> 28);
+    t = 0x3333000033330000ULL & (x ^ (x << 14));
+    x ^= t ^ (t >> 14);
+    t = 0x5500550055005500ULL & (x ^ (x << 7));
+    x ^= t ^ (t >> 7);
+    return x;
+}
 
-// Parallel Negamax
-// Basic parallel Negamax return the best score for color
-// depth is how many moves ahead to explore
+/*
+	the 8 symmetries of the board: bit 2 of sym transposes, bit 1
+	mirrors left to right, bit 0 flips top to bottom, in that order.
+*/
+static inline ull Transform(ull x, int sym) {
+    if (sym & 4) x = Transpose(x);
+    if (sym & 2) x = MirrorHorizontal(x);
+    if (sym & 1) x = FlipVertical(x);
+    return x;
+}
+
+static inline void TransformAll(ull x, ull *t) {
+    t[0] = x;
+    t[1] = FlipVertical(x);
+    t[2] = MirrorHorizontal(x);
+    t[3] = FlipVertical(t[2]);
+    t[4] = Transpose(x);
+    t[5] = FlipVertical(t[4]);
+    t[6] = MirrorHorizontal(t[4]);
+    t[7] = FlipVertical(t[6]);
+}
 
-int Negamax(const Board &b, int color, int depth) {
-    if (depth == 0 || GameIsOver(b)) {
-        return EvaluateBoard(b, color);
+// the empty squares next to a disk in x
+static inline ull Neighbours(ull x) {
+    ull n = (x << 8) | (x >> 8);
+    n |= ((x << 1) | (x << 9) | (x >> 7)) & ~COL8;
+    n |= ((x >> 1) | (x >> 9) | (x << 7)) & ~COL1;
+    return n;
+}
+
+// gather the bits of x under mask into the low bits, like PEXT
+static inline ull ExtractBits(ull x, ull mask) {
+    ull bits = 0;
+    for (ull bit = 1; mask; mask &= mask - 1, bit <<= 1) {
+        if (x & mask & -mask) bits |= bit;
     }
+    return bits;
+}
 
-    Board legalMoves;
-    int numMoves = EnumerateLegalMoves(b, color, &legalMoves);
-    if (numMoves == 0) {
-        return -Negamax(b, OTHERCOLOR(color), depth - 1);
-    }
-
-    // Use serial execution for depths below the cutoff
-    if (depth <= CUTOFF_DEPTH) {
-        int bestValue = -9999999;
-        ull bits = legalMoves.disks[color];
-        for (int row = 8; row >= 1; row--) {
-            ull thisrow = bits & ROW8;
-            for (int col = 8; thisrow && col >= 1; col--) {
-                if (thisrow & COL8) {
-                    Move m = {row, col};
-                    Board child;
-                    MakeMove(&b, color, m, &child);
-                    int val = -Negamax(child, OTHERCOLOR(color), depth - 1);
-                    if (val > bestValue) bestValue = val;
-                }
-                thisrow >>= 1;
-            }
-            bits >>= 8;
+static void PatternIndicesScalar(ull black, ull white, unsigned short *index) {
+    ull x[8], o[8];
+    TransformAll(black, x);
+    TransformAll(white, o);
+    for (int i = 0; i < ninstances; i++) {
+        ull mask = shape_mask[instances[i].shape];
+        int s = instances[i].sym;
+        index[i] = base3[ExtractBits(x[s], mask)] + 2 * base3[ExtractBits(o[s], mask)];
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("bmi2")))
+static void PatternIndicesBMI2(ull black, ull white, unsigned short *index) {
+    ull x[8], o[8];
+    TransformAll(black, x);
+    TransformAll(white, o);
+    for (int i = 0; i < ninstances; i++) {
+        ull mask = shape_mask[instances[i].shape];
+        int s = instances[i].sym;
+        index[i] = base3[_pext_u64(x[s], mask)] + 2 * base3[_pext_u64(o[s], mask)];
+    }
+}
+#endif
+
+static void (*pattern_indices_kernel)(ull black, ull white, unsigned short *index) = PatternIndicesScalar;
+
+/*
+	build the instances of every shape and the table layout. usepext
+	selects PEXT extraction if the cpu has BMI2.
+*/
+static void InitPatterns(int usepext) {
+    pow3[0] = 1;
+    for (int i = 1; i <= MAX_SHAPE_SQUARES; i++) pow3[i] = 3 * pow3[i - 1];
+    for (int bits = 0; bits < (1 << MAX_SHAPE_SQUARES); bits++) {
+        base3[bits] = 0;
+        for (int i = 0; i < MAX_SHAPE_SQUARES; i++) {
+            if (bits & (1 << i)) base3[bits] += pow3[i];
         }
-        return bestValue;
-    } else {
-        cilk::reducer< cilk::op_max<int> > bestValue(-9999999);
-        Move moveList[64];
-        int idx = 0;
-        ull bits = legalMoves.disks[color];
-        for (int row = 8; row >= 1; row--) {
-            ull thisrow = bits & ROW8;
-            for (int col = 8; thisrow && col >= 1; col--) {
-                if (thisrow & COL8) {
-                    moveList[idx].row = row;
-                    moveList[idx].col = col;
-                    idx++;
+    }
+
+    ninstances = 0;
+    for (int p = 0; p < NSHAPES; p++) {
+        ull mask = 0ULL;
+        for (int i = 0; i < shapes[p].nsquares; i++) {
+            mask |= BOARD_BIT(shapes[p].squares[i].row, shapes[p].squares[i].col);
+        }
+        shape_mask[p] = mask;
+        table_size[p] = pow3[shapes[p].nsquares];
+
+        // one instance per distinct set of squares the symmetries map onto the shape
+        ull seen[8];
+        int nseen = 0;
+        for (int sym = 0; sym < 8; sym++) {
+            PatternInstance *inst = &instances[ninstances];
+            ull covered = 0ULL;
+            for (int sq = 0; sq < 64; sq++) {
+                ull image = Transform(0x1ULL << sq, sym);
+                if (image & mask) {
+                    covered |= 0x1ULL << sq;
+                    inst->squares[__builtin_popcountll(mask & (image - 1))] = sq;
                 }
-                thisrow >>= 1;
             }
-            bits >>= 8;
+            int dup = 0;
+            for (int k = 0; k < nseen; k++) dup |= (seen[k] == covered);
+            if (dup) continue;
+            if (ninstances == MAX_INSTANCES) {
+                fprintf(stderr, "too many pattern instances: raise MAX_INSTANCES\n");
+                exit(1);
+            }
+            seen[nseen++] = covered;
+            inst->shape = p;
+            inst->sym = sym;
+            ninstances++;
         }
-
-        cilk_for (int i = 0; i < idx; i++) {
-            Board child;
-            MakeMove(&b, color, moveList[i], &child);
-            int val = -Negamax(child, OTHERCOLOR(color), depth - 1);
-            bestValue->calc_max(val);
+    }
+    memset(nsquare_digits, 0, sizeof(nsquare_digits));
+    for (int i = 0; i < ninstances; i++) {
+        for (int k = 0; k < shapes[instances[i].shape].nsquares; k++) {
+            int sq = instances[i].squares[k];
+            PatternDigit d = { (unsigned short)i, (unsigned short)pow3[k] };
+            square_digits[sq][nsquare_digits[sq]++] = d;
         }
-
-        return bestValue.get_value();
     }
+    table_size[EVAL_MOBILITY] = table_size[EVAL_OPP_MOBILITY] = 64;
+    table_size[EVAL_POTENTIAL] = table_size[EVAL_OPP_POTENTIAL] = 64;
+    table_size[EVAL_PARITY] = 2;
+    phase_size = 0;
+    for (int t = 0; t < EVAL_TABLES; t++) {
+        table_offset[t] = phase_size;
+        phase_size += table_size[t];
+    }
+
+    pattern_indices_kernel = PatternIndicesScalar;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (usepext && __builtin_cpu_supports("bmi2")) pattern_indices_kernel = PatternIndicesBMI2;
+#endif
 }
 
+// positions with fewer than the 4 disks of the start fall in phase 0
+static inline int EvalPhase(const EvalWeights *e, ull occupied) {
+    int disks = __builtin_popcountll(occupied) - 4;
+    return (disks > 0) ? disks * e->phases / 61 : 0;
+}
 
+/*
+	the pattern score for color under weights e, given the pattern
+	indices of the position (as PatternIndices*, or kept up to date by
+	MakeMove).
+*/
+static int PatternScore(const EvalWeights *e, ull me, ull opp, int color, const unsigned short *index) {
+    ull empty = ~(me | opp);
+    const short *w = e->tables[color] + EvalPhase(e, me | opp) * phase_size;
 
-// Define a "root" function that enumerates moves, sand then picks the best index.
-int NegamaxRoot(const Board &b, int color, int depth, Move *bestMove) {
-    Board legalMoves;
-    int numMoves = EnumerateLegalMoves(b, color, &legalMoves);
-    if (numMoves == 0) {
-        bestMove->row = 0;
-        bestMove->col = 0;
-        return -Negamax(b, OTHERCOLOR(color), depth - 1);
+    int sum = 0;
+    for (int i = 0; i < ninstances; i++) {
+        sum += w[table_offset[instances[i].shape] + index[i]];
     }
+    sum += w[table_offset[EVAL_MOBILITY] + __builtin_popcountll(LegalMoves(me, opp))];
+    sum += w[table_offset[EVAL_OPP_MOBILITY] + __builtin_popcountll(LegalMoves(opp, me))];
+    sum += w[table_offset[EVAL_POTENTIAL] + __builtin_popcountll(Neighbours(opp) & empty)];
+    sum += w[table_offset[EVAL_OPP_POTENTIAL] + __builtin_popcountll(Neighbours(me) & empty)];
+    sum += w[table_offset[EVAL_PARITY] + (__builtin_popcountll(empty) & 1)];
 
-    Move moveList[64];
-    int idx = 0;
-    ull moves = legalMoves.disks[color];
-    while (moves) {
-        ull next = moves & -moves;
-        int bitpos = __builtin_ctzll(next);
-        int row = 8 - (bitpos / 8);
-        int col = 8 - (bitpos % 8);
-        moveList[idx].row = row;
-        moveList[idx].col = col;
-        idx++;
-        moves ^= next;
-    }
+    int score = (sum >= 0) ? (sum + EVAL_UNIT / 2) / EVAL_UNIT : -((-sum + EVAL_UNIT / 2) / EVAL_UNIT);
+    if (score > EVAL_MAX) score = EVAL_MAX;
+    if (score < -EVAL_MAX) score = -EVAL_MAX;
+    return score;
+}
 
-    int scores[64];
-    cilk_for (int i = 0; i < idx; i++) {
-        Board child;
-        MakeMove(&b, color, moveList[i], &child);
-        scores[i] = -Negamax(child, OTHERCOLOR(color), depth - 1);
-    }
+int PatternEval(const EvalWeights *e, const Board &b, int color) {
+    unsigned short index[MAX_INSTANCES];
+    pattern_indices_kernel(b.disks[X_BLACK], b.disks[O_WHITE], index);
+    return PatternScore(e, b.disks[color], b.disks[OTHERCOLOR(color)], color, index);
+}
+
+// Evaluate the board with weights e, or by counting disks without
+int EvaluateBoard(const Board &b, int color, const EvalWeights *e) {
+    if (e) return PatternEval(e, b, color);
+    return DiskDifference(b, color);
+}
 
-    int bestVal = scores[0];
-    int bestIdx = 0;
-    for (int i = 1; i < idx; i++) {
-        if (scores[i] > bestVal) {
-            bestVal = scores[i];
-            bestIdx = i;
+/*
+	weights file, little endian:
+	    char  magic[8]          "OTHEVAL1"
+	    int32 nphases
+	    int32 ntables           EVAL_TABLES
+	    int32 size[ntables]     entries in each table, as in table_size
+	    int16 weights[nphases][sum of size]
+	phase p covers positions with (disks - 4) * nphases / 61 == p, and
+	phase 0 those with fewer than 4 disks too.
+*/
+/*
+	weights from w (nphases phases, owned from now on): build the copy
+	for O to move with 1 and 2 swapped in every pattern index, and a
+	salt that only the same weights share.
+*/
+static EvalWeights *NewEvalWeights(const char *name, short *w, int nphases) {
+    EvalWeights *e = (EvalWeights *)malloc(sizeof(EvalWeights));
+    e->name = name;
+    e->phases = nphases;
+    short *swapped = (short *)malloc((size_t)nphases * phase_size * sizeof(short));
+    memcpy(swapped, w, (size_t)nphases * phase_size * sizeof(short));
+    for (int p = 0; p < nphases; p++) {
+        for (int s = 0; s < NSHAPES; s++) {
+            const short *from = w + p * phase_size + table_offset[s];
+            short *to = swapped + p * phase_size + table_offset[s];
+            for (int index = 0; index < table_size[s]; index++) {
+                int other = 0;
+                for (int k = 0, rest = index; k < shapes[s].nsquares; k++, rest /= 3) {
+                    if (rest % 3) other += (3 - rest % 3) * pow3[k];
+                }
+                to[other] = from[index];
+            }
         }
     }
-    *bestMove = moveList[bestIdx];
-    return bestVal;
+    e->tables[X_BLACK] = w;
+    e->tables[O_WHITE] = swapped;
+
+    // FNV-1a over the weights; never 0, which is the disk count's
+    ull salt = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < (size_t)nphases * phase_size; i++) {
+        salt = (salt ^ (unsigned short)w[i]) * 0x100000001B3ULL;
+    }
+    e->salt = salt ? salt : 1;
+    track_patterns = 1;
+    return e;
 }
 
-// Computer Turn
-int ComputerTurn(Board *b, int color, int depth) {
-    // Check if there's a legal move
-    Board legal;
-    int num_moves = EnumerateLegalMoves(*b, color, &legal);
-    if (num_moves == 0) {
+static const char eval_magic[8] = { 'O', 'T', 'H', 'E', 'V', 'A', 'L', '1' };
+
+// the weights in path, or 0 if it cannot be read
+static EvalWeights *LoadEvalWeights(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    char magic[8];
+    int nphases, ntables, sizes[EVAL_TABLES];
+    int ok = fread(magic, 1, 8, f) == 8 && memcmp(magic, eval_magic, 8) == 0 &&
+             fread(&nphases, sizeof(int), 1, f) == 1 && nphases > 0 && nphases <= 61 &&
+             fread(&ntables, sizeof(int), 1, f) == 1 && ntables == EVAL_TABLES &&
+             fread(sizes, sizeof(int), EVAL_TABLES, f) == EVAL_TABLES &&
+             memcmp(sizes, table_size, sizeof(sizes)) == 0;
+    short *w = 0;
+    if (ok) {
+        size_t n = (size_t)nphases * phase_size;
+        w = (short *)malloc(n * sizeof(short));
+        ok = w && fread(w, sizeof(short), n, f) == n;
+    }
+    fclose(f);
+    if (!ok) {
+        fprintf(stderr, "%s: not a weights file for these patterns\n", path);
+        free(w);
         return 0;
     }
+    return NewEvalWeights(path, w, nphases);
+}
 
-    Move bestM;
-    int bestScore = NegamaxRoot(*b, color, depth, &bestM);
+static int WriteEvalWeights(const char *path, const EvalWeights *e) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    int ntables = EVAL_TABLES;
+    size_t n = (size_t)e->phases * phase_size;
+    int ok = fwrite(eval_magic, 1, 8, f) == 8 &&
+             fwrite(&e->phases, sizeof(int), 1, f) == 1 &&
+             fwrite(&ntables, sizeof(int), 1, f) == 1 &&
+             fwrite(table_size, sizeof(int), EVAL_TABLES, f) == EVAL_TABLES &&
+             fwrite(e->tables[X_BLACK], sizeof(short), n, f) == n;
+    if (fclose(f) != 0) ok = 0;
+    if (!ok) perror(path);
+    return ok;
+}
 
-    printf("\n[%c] Computer chooses move (%d, %d) => Score: %d\n",
-           (color==X_BLACK ? 'X':'O'), bestM.row, bestM.col, bestScore);
+/*
+	hand-made starting weights, not trained: a positional square table
+	fading into the disk count as the game goes on, plus mobility early
+	and parity late. each square's value is shared out among the
+	instances that cover it.
+*/
+#define SEED_PHASES 12
 
-    int flips = FlipDisks(bestM, b, color, 1, 1);
-    PlaceOrFlip(bestM, b, color);
+static EvalWeights *SeedEvalWeights(void) {
+    static const int square_value[64] = {
+        100, -20,  10,   5,   5,  10, -20, 100,
+        -20, -50,  -2,  -2,  -2,  -2, -50, -20,
+         10,  -2,  -1,  -1,  -1,  -1,  -2,  10,
+          5,  -2,  -1,  -1,  -1,  -1,  -2,   5,
+          5,  -2,  -1,  -1,  -1,  -1,  -2,   5,
+         10,  -2,  -1,  -1,  -1,  -1,  -2,  10,
+        -20, -50,  -2,  -2,  -2,  -2, -50, -20,
+        100, -20,  10,   5,   5,  10, -20, 100
+    };
+    int cover[64] = { 0 };
+    for (int i = 0; i < ninstances; i++) {
+        for (int k = 0; k < shapes[instances[i].shape].nsquares; k++) cover[instances[i].squares[k]]++;
+    }
 
-    printf("%c flipped %d disks.\n", (color==X_BLACK ? 'X':'O'), flips);
-    PrintBoard(*b);
-    return 1; 
+    short *weights = (short *)calloc((size_t)SEED_PHASES * phase_size, sizeof(short));
+    for (int p = 0; p < SEED_PHASES; p++) {
+        double late = (double)p / (SEED_PHASES - 1);
+        short *w = weights + p * phase_size;
+        double value[64];
+        for (int sq = 0; sq < 64; sq++) {
+            value[sq] = EVAL_UNIT * ((1 - late) * square_value[sq] / 10.0 + late) / cover[sq];
+        }
+        for (int s = 0; s < NSHAPES; s++) {
+            // the identity instance of each shape comes first
+            const PatternInstance *inst = &instances[0];
+            while (inst->shape != s) inst++;
+            for (int index = 0; index < table_size[s]; index++) {
+                double v = 0;
+                for (int k = 0, rest = index; k < shapes[s].nsquares; k++, rest /= 3) {
+                    if (rest % 3 == 1) v += value[inst->squares[k]];
+                    if (rest % 3 == 2) v -= value[inst->squares[k]];
+                }
+                w[table_offset[s] + index] = (short)(v >= 0 ? v + 0.5 : v - 0.5);
+            }
+        }
+        for (int m = 0; m < 64; m++) {
+            w[table_offset[EVAL_MOBILITY] + m] = (short)((1 - late) * m * EVAL_UNIT / 2);
+            w[table_offset[EVAL_OPP_MOBILITY] + m] = (short)(-(1 - late) * m * EVAL_UNIT / 2);
+            w[table_offset[EVAL_POTENTIAL] + m] = (short)((1 - late) * m * EVAL_UNIT / 4);
+            w[table_offset[EVAL_OPP_POTENTIAL] + m] = (short)(-(1 - late) * m * EVAL_UNIT / 4);
+        }
+        w[table_offset[EVAL_PARITY] + 1] = (short)(late * EVAL_UNIT);
+    }
+    return NewEvalWeights("seed", weights, SEED_PHASES);
 }
 
+/*
+	the weights a --eval option names: a weights file, "seed" for the
+	hand-made weights or "disks" for none (*e = 0). returns 0 if the
+	file cannot be read.
+*/
+static int OpenEval(const char *name, const EvalWeights **e) {
+    if (strcmp(name, "disks") == 0) {
+        *e = 0;
+    } else if (strcmp(name, "seed") == 0) {
+        *e = SeedEvalWeights();
+    } else {
+        *e = LoadEvalWeights(name);
+    }
+    return *e != 0 || strcmp(name, "disks") == 0;
+}
 
-// Main
-int main() {
-    Board gameboard = start;
-    PrintBoard(gameboard);
 
-    char p1type, p2type;
-    int p1depth = 0, p2depth = 0;
+/*
+	Zobrist hashing: a random key per (color, square), XORed together
+	for every disk on the board, plus one more key when O is to move.
+*/
+static ull zobrist[2][64];
+static ull zobrist_o_to_move;
 
-    printf("Is Player 1 (X) [h]uman or [c]omputer? ");
-    scanf(" %c", &p1type);
-    if (p1type == 'c') {
-        printf("Enter search depth for X (1..60): ");
-        scanf("%d", &p1depth);
+static void InitZobrist(void) {
+    ull seed = 0x2545F4914F6CDD1DULL;
+    for (int c = 0; c < 2; c++) {
+        for (int sq = 0; sq < 64; sq++) zobrist[c][sq] = NextRandom(&seed);
     }
+    zobrist_o_to_move = NextRandom(&seed);
+}
 
-    printf("Is Player 2 (O) [h]uman or [c]omputer? ");
-    scanf(" %c", &p2type);
-    if (p2type == 'c') {
-        printf("Enter search depth for O (1..60): ");
-        scanf("%d", &p2depth);
+static ull HashBoard(const Board &b, int color) {
+    ull key = (color == O_WHITE) ? zobrist_o_to_move : 0ULL;
+    for (int c = 0; c < 2; c++) {
+        for (ull bits = b.disks[c]; bits; bits &= bits - 1) {
+            key ^= zobrist[c][__builtin_ctzll(bits)];
+        }
     }
+    return key;
+}
 
-    int currentColor = X_BLACK; 
-    int movePossibleX = 1, movePossibleO = 1;
+/*
+	a search node: the board plus what is derived from it, kept up to
+	date by MakeMove from the flips of each move instead of being
+	recomputed at every node. the pattern indices are only kept while
+	some player evaluates with patterns. positions are copied to make a
+	move, so undoing one is just dropping the child.
+*/
+typedef struct {
+    Board board;
+    ull key;                            // Zobrist key of the disks, without the side to move
+    int count[2];                       // disks of each color
+    int empties;
+    unsigned short index[MAX_INSTANCES];   // pattern indices (0 empty, 1 X, 2 O)
+} Position;
 
-    while (true) {
-        int moveMade = 0;
-        if (currentColor == X_BLACK) {
-            if (p1type == 'h') {
-                moveMade = HumanTurn(&gameboard, X_BLACK);
-            } else {
-                moveMade = ComputerTurn(&gameboard, X_BLACK, p1depth);
-            }
-            movePossibleX = moveMade;
-        } else {
-            if (p2type == 'h') {
-                moveMade = HumanTurn(&gameboard, O_WHITE);
-            } else {
-                moveMade = ComputerTurn(&gameboard, O_WHITE, p2depth);
+static inline ull PositionKey(const Position &p, int color) {
+    return (color == O_WHITE) ? p.key ^ zobrist_o_to_move : p.key;
+}
+
+static void SetPosition(Position *p, const Board &b) {
+    p->board = b;
+    p->key = HashBoard(b, X_BLACK);
+    p->count[X_BLACK] = __builtin_popcountll(b.disks[X_BLACK]);
+    p->count[O_WHITE] = __builtin_popcountll(b.disks[O_WHITE]);
+    p->empties = 64 - p->count[X_BLACK] - p->count[O_WHITE];
+    if (track_patterns) pattern_indices_kernel(b.disks[X_BLACK], b.disks[O_WHITE], p->index);
+}
+
+// Copy old and play color's disk on square sq; returns the number of flips
+static int MakeMove(const Position *old, int color, int sq, Position *p) {
+    ull flips = FlipMask(sq, old->board.disks[color], old->board.disks[OTHERCOLOR(color)]);
+    int nflips = __builtin_popcountll(flips);
+    *p = *old;
+    ApplyFlips(&p->board, color, sq, flips);
+    p->count[color] += nflips + 1;
+    p->count[OTHERCOLOR(color)] -= nflips;
+    p->empties--;
+
+    ull key = p->key ^ zobrist[color][sq];
+    for (ull f = flips; f; f &= f - 1) {
+        int fsq = __builtin_ctzll(f);
+        key ^= zobrist[X_BLACK][fsq] ^ zobrist[O_WHITE][fsq];
+    }
+    p->key = key;
+
+    if (track_patterns) {
+        // the new disk's digit goes from 0 to color + 1; a flipped one
+        // goes from the other color's digit to this one's
+        unsigned short *index = p->index;
+        int place = color + 1, flip = (color == X_BLACK) ? -1 : 1;
+        for (int k = 0; k < nsquare_digits[sq]; k++) {
+            index[square_digits[sq][k].instance] += place * square_digits[sq][k].power;
+        }
+        for (ull f = flips; f; f &= f - 1) {
+            int fsq = __builtin_ctzll(f);
+            for (int k = 0; k < nsquare_digits[fsq]; k++) {
+                index[square_digits[fsq][k].instance] += flip * square_digits[fsq][k].power;
             }
-            movePossibleO = moveMade;
         }
+    }
+    return nflips;
+}
 
-        if (!movePossibleX && !movePossibleO) {
-            break;
-        }
+// Evaluate the position for color with weights e, or by counting disks without
+static inline int EvaluatePosition(const Position &p, int color, const EvalWeights *e) {
+    if (e) {
+        return PatternScore(e, p.board.disks[color], p.board.disks[OTHERCOLOR(color)], color, p.index);
+    }
+    return p.count[color] - p.count[OTHERCOLOR(color)];
+}
 
 
-        currentColor = 1 - currentColor; 
-    }
+/*
+	per-worker counters, each on its own cache line so workers never
+	share a line when they bump them.
+*/
+#define MAX_WORKERS 256
+#define MAX_PLY 64
+
+/*
+	statistics are kept unless compiled with -DNO_STATS: STAT(x)
+	evaluates x only then, so that build does no counting at all (x
+	still counts as a use of what it names). WORKER_STATS(a) is the
+	calling worker's element of the per-worker array a, and a null
+	pointer in that build, so finding the worker is compiled out too.
+*/
+#ifdef NO_STATS
+#define STAT(x) ((void) sizeof(x))
+#define WORKER_STATS(a) ((__typeof__(&(a)[0])) 0)
+#else
+#define STAT(x) ((void) (x))
+#define WORKER_STATS(a) (&(a)[WorkerId()])
+#endif
+
+static inline int WorkerId(void) {
+    int w = ParWorkerId();
+    return (w >= 0 && w < MAX_WORKERS) ? w : 0;
+}
+
+typedef struct {
+    ull probes;
+    ull hits;
+    ull collisions;    // misses in a bucket holding other positions
+    ull stores;
+    ull replacements;  // stores that evicted a different position
+} __attribute__((aligned(64))) TTStats;
+
+static TTStats ttstats[MAX_WORKERS];
+static TTStats cachestats[MAX_WORKERS];   // of the persistent cache
 
+// how the search's nodes ended, by worker
+typedef struct {
+    ull plies[MAX_PLY];   // nodes by ply from the root, the last also counting deeper ones
+    ull leaves;           // evaluated at the horizon
+    ull terminals;        // game over
+    ull passes;           // the side to move had to pass
+    ull ttcuts;           // returned a bound from the table
+    ull cutoffs;          // failed high
+    ull firstcuts;        // failed high on the first move searched
+    ull reused;           // hit a table entry an earlier computer move stored
+    ull reusedcuts;       // and returned its bound
+} __attribute__((aligned(64))) NodeStats;
+
+static NodeStats nodestats[MAX_WORKERS];
+
+#define NODE_STAT(field) STAT(nodestats[WorkerId()].field++)
+
+
+/*
+	transposition table shared by all workers, without locks. an entry
+	is a (check, data) pair where check = key ^ data. a reader that
+	sees a half-written entry computes the wrong key and treats it as a
+	miss, so a torn write can never be mistaken for a hit.
+
+	data packs the score (16 bits), the depth it was searched to, the
+	bound type, the best move and the generation: the computer move
+	whose search stored it, so the table carries over from move to
+	move. buckets hold 4 entries on one cache line; a store replaces
+	the same position, else an empty entry, else the one worth least:
+	the shallowest, counting TT_AGE_PLIES less for every generation
+	it is old.
+*/
+#define BOUND_UPPER 1
+#define BOUND_LOWER 2
+#define BOUND_EXACT 3
+
+#define NO_MOVE 64
+
+#define TT_DATA(score, depth, bound, move) \
+    ((ull)(unsigned short)(score) | ((ull)(depth) << 16) | ((ull)(bound) << 24) | ((ull)(move) << 32))
+#define TT_SCORE(d) ((int)(short)((d) & 0xffff))
+#define TT_DEPTH(d) ((int)(((d) >> 16) & 0xff))
+#define TT_BOUND(d) ((int)(((d) >> 24) & 0x3))
+#define TT_MOVE(d)  ((int)(((d) >> 32) & 0xff))
+#define TT_GEN(d)   ((int)(((d) >> 40) & 0xff))
+
+#define TT_AGE_PLIES 2
+
+static int tt_generation = 0;
+
+// nodes closer to the leaves than this are not worth a probe
+#define TT_MIN_DEPTH 2
+
+typedef struct { volatile ull check; volatile ull data; } TTEntry;
+
+typedef struct { TTEntry slot[4]; } __attribute__((aligned(64))) TTBucket;
+
+static TTBucket *tt = 0;
+static ull ttmask;
+
+/*
+	allocate a table of the largest power-of-two number of buckets
+	that fits in mb megabytes. mb == 0 disables the table.
+	returns 0 if the allocation failed.
+*/
+static int InitTT(long mb) {
+    free(tt);
+    tt = 0;
+    if (mb <= 0) return 1;
+    ull nbuckets = 1;
+    while (nbuckets * 2 * sizeof(TTBucket) <= (ull)mb << 20) nbuckets *= 2;
+    void *mem;
+    if (posix_memalign(&mem, sizeof(TTBucket), nbuckets * sizeof(TTBucket)) != 0) return 0;
+    memset(mem, 0, nbuckets * sizeof(TTBucket));
+    tt = (TTBucket *)mem;
+    ttmask = nbuckets - 1;
+    return 1;
+}
+
+// look key up in bucket, counting in st
+static inline bool ProbeBucket(const TTBucket *bucket, ull key, ull *data, TTStats *st) {
+    bool occupied = false;
+    STAT(st->probes++);
+    for (int i = 0; i < 4; i++) {
+        ull d = bucket->slot[i].data;
+        ull c = bucket->slot[i].check;
+        if ((c ^ d) == key) {
+            STAT(st->hits++);
+            *data = d;
+            return true;
+        }
+        if (d) occupied = true;
+    }
+    if (occupied) STAT(st->collisions++);
+    return false;
+}
+
+static inline void StoreBucket(TTBucket *bucket, ull key, ull data, TTStats *st) {
+    TTEntry *victim = 0;
+    int victimWorth = 1 << 30;
+    bool replaced = true;
+    for (int i = 0; i < 4; i++) {
+        ull d = bucket->slot[i].data;
+        ull c = bucket->slot[i].check;
+        if ((c ^ d) == key || d == 0) {
+            victim = &bucket->slot[i];
+            replaced = false;
+            break;
+        }
+        int worth = TT_DEPTH(d) - TT_AGE_PLIES * ((TT_GEN(data) - TT_GEN(d)) & 0xff);
+        if (worth < victimWorth) {
+            victim = &bucket->slot[i];
+            victimWorth = worth;
+        }
+    }
+    STAT(st->stores++);
+    if (replaced) STAT(st->replacements++);
+
+    victim->check = key ^ data;
+    victim->data = data;
+}
+
+static bool ProbeTT(ull key, ull *data) {
+    return ProbeBucket(&tt[key & ttmask], key, data, WORKER_STATS(ttstats));
+}
+
+static void StoreTT(ull key, int score, int depth, int bound, int move) {
+    ull data = TT_DATA(score, depth, bound, move) | ((ull)tt_generation << 40);
+    StoreBucket(&tt[key & ttmask], key, data, WORKER_STATS(ttstats));
+}
+
+/*
+	persistent cache: a table like the transposition table in a file
+	mapped into memory, so the deep results of one run are there for
+	the next. only nodes CACHE_MIN_DEPTH or more plies from the horizon
+	and roots use it; the transposition table is probed first.
+
+	the first process to open the file takes an flock on it and is its
+	one writer; others opening it meanwhile map it read-only and only
+	probe. a reader that finds the file still being created waits up to
+	CACHE_WAIT seconds for the writer to stamp its magic, then runs
+	without the cache. entries are written as in the transposition
+	table, so a reader in another process that catches one half written
+	sees a miss. the kernel writes the pages back to the file.
+
+	    char  magic[8]       "OTHCACH1"
+	    int64 nbuckets       a power of two
+	    int64 fingerprint    zobrist_o_to_move: keys from another build don't match
+	    (padding to CACHE_HEADER bytes)
+	    TTBucket bucket[nbuckets]
+*/
+#define CACHE_MIN_DEPTH 5
+#define CACHE_HEADER 64
+#define CACHE_WAIT 10
+
+static const char cache_magic[8] = { 'O', 'T', 'H', 'C', 'A', 'C', 'H', '1' };
+
+static TTBucket *cache = 0;
+static ull cachemask;
+static int cache_writable = 0;
+
+static inline bool ProbeCache(ull key, ull *data) {
+    return cache && ProbeBucket(&cache[key & cachemask], key, data, WORKER_STATS(cachestats));
+}
+
+static inline void StoreCache(ull key, int score, int depth, int bound, int move) {
+    if (cache_writable) {
+        StoreBucket(&cache[key & cachemask], key, TT_DATA(score, depth, bound, move), WORKER_STATS(cachestats));
+    }
+}
+
+// whether the cache in fd has its magic, waiting for the writer creating it if not yet
+static bool CacheStamped(int fd) {
+    struct timespec ts = { 0, 10000000 };
+    for (int i = 0; i < CACHE_WAIT * 100; i++) {
+        struct stat st;
+        char magic[8];
+        if (fstat(fd, &st) == 0 && st.st_size > CACHE_HEADER && pread(fd, magic, 8, 0) == 8 &&
+            memcmp(magic, cache_magic, 8) == 0) {
+            return true;
+        }
+        nanosleep(&ts, 0);
+    }
+    return false;
+}
+
+/*
+	open the cache in path, creating it with the largest power-of-two
+	number of buckets that fits in mb megabytes if it does not exist.
+	returns 0 if path cannot be used as a cache; 1 without opening it
+	if another process is creating it and does not finish in time.
+*/
+static int OpenCache(const char *path, long mb) {
+    int fd = open(path, O_RDWR | O_CREAT, 0666);
+    int writer = (fd >= 0 && flock(fd, LOCK_EX | LOCK_NB) == 0);
+    if (fd >= 0 && !writer) {
+        close(fd);
+        fd = open(path, O_RDONLY);
+        if (fd >= 0 && !CacheStamped(fd)) {
+            fprintf(stderr, "%s: the cache is still being created, running without it\n", path);
+            close(fd);
+            return 1;
+        }
+    }
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+
+    size_t size = st.st_size;
+    if (size == 0 && writer) {
+        ull nbuckets = 1;
+        while (nbuckets * 2 * sizeof(TTBucket) <= (ull)mb << 20) nbuckets *= 2;
+        size = CACHE_HEADER + nbuckets * sizeof(TTBucket);
+        if (ftruncate(fd, size) != 0) {
+            perror(path);
+            close(fd);
+            return 0;
+        }
+    }
+    char *map = (char *)MAP_FAILED;
+    if (size > CACHE_HEADER) {
+        map = (char *)mmap(0, size, writer ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    }
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "%s: cannot map the cache\n", path);
+        close(fd);
+        return 0;
+    }
+
+    ull header[3];
+    if (st.st_size == 0) {
+        // new: the magic goes in last, once the header is whole
+        header[1] = (size - CACHE_HEADER) / sizeof(TTBucket);
+        header[2] = zobrist_o_to_move;
+        memcpy(map + 8, &header[1], 2 * sizeof(ull));
+        memcpy(map, cache_magic, 8);
+    }
+    memcpy(header, map, sizeof(header));
+    ull nbuckets = header[1];
+    if (memcmp(map, cache_magic, 8) != 0 || header[2] != zobrist_o_to_move ||
+        (nbuckets & (nbuckets - 1)) != 0 || size != CACHE_HEADER + nbuckets * sizeof(TTBucket)) {
+        fprintf(stderr, "%s: not a cache for this program\n", path);
+        munmap(map, size);
+        close(fd);
+        return 0;
+    }
+
+    // the writer keeps fd, and its lock, open until it exits
+    if (!writer) close(fd);
+    cache = (TTBucket *)(map + CACHE_HEADER);
+    cachemask = nbuckets - 1;
+    cache_writable = writer;
+    return 1;
+}
+
+static void ClearTTStats(void) {
+    memset(ttstats, 0, sizeof(ttstats));
+    memset(cachestats, 0, sizeof(cachestats));
+}
+
+#ifndef NO_STATS
+static TTStats SumTTStats(const TTStats *stats) {
+    TTStats sum;
+    memset(&sum, 0, sizeof(sum));
+    for (int w = 0; w < MAX_WORKERS; w++) {
+        sum.probes += stats[w].probes;
+        sum.hits += stats[w].hits;
+        sum.collisions += stats[w].collisions;
+        sum.stores += stats[w].stores;
+        sum.replacements += stats[w].replacements;
+    }
+    return sum;
+}
+
+#endif
+
+static void PrintTTStats(void) {
+#ifndef NO_STATS
+    if (tt) {
+        TTStats st = SumTTStats(ttstats);
+        printf("TT: %llu probes, %llu hits (%.1f%%), %llu collisions, %llu stores, %llu replacements\n",
+               st.probes, st.hits, st.probes ? 100.0 * st.hits / st.probes : 0.0,
+               st.collisions, st.stores, st.replacements);
+    }
+    if (cache) {
+        TTStats st = SumTTStats(cachestats);
+        printf("Cache: %llu probes, %llu hits (%.1f%%), %llu stores, %llu replacements\n",
+               st.probes, st.hits, st.probes ? 100.0 * st.hits / st.probes : 0.0,
+               st.stores, st.replacements);
+    }
+#endif
+}
+
+static void ClearNodeStats(void) {
+    memset(nodestats, 0, sizeof(nodestats));
+}
+
+#ifndef NO_STATS
+static void SumNodeStats(NodeStats *sum) {
+    memset(sum, 0, sizeof(*sum));
+    for (int w = 0; w < MAX_WORKERS; w++) {
+        const NodeStats *st = &nodestats[w];
+        for (int ply = 0; ply < MAX_PLY; ply++) sum->plies[ply] += st->plies[ply];
+        sum->leaves += st->leaves;
+        sum->terminals += st->terminals;
+        sum->passes += st->passes;
+        sum->ttcuts += st->ttcuts;
+        sum->cutoffs += st->cutoffs;
+        sum->firstcuts += st->firstcuts;
+        sum->reused += st->reused;
+        sum->reusedcuts += st->reusedcuts;
+    }
+}
+#endif
+
+
+/*
+	a split point is a node whose younger children are searched in
+	parallel. it holds the node's search window as the children raise
+	it. when a child fails high the split point is cut off, and its
+	other children and everything below them stop early.
+*/
+typedef struct SplitPoint {
+    volatile int cutoff;
+    volatile int alpha;
+    volatile ull best;    // PACK_SCORE(best value, best square)
+    int beta;
+    struct SplitPoint *parent;
+    struct Search *search;
+    int worker;           // that spawned the tasks
+    double began;         // for the tracer: Now() when it did
+#ifdef PROFILE
+    volatile ull work;    // cycles of the tasks spawned here, summed
+    volatile ull span;    // the longest of their spans
+    ull start;            // cycles when they were spawned
+    struct TaskProfile *task;   // the task that spawned them
+#endif
+} SplitPoint;
+
+// what one worker did in a search: nodes visited, tasks spawned
+typedef struct {
+    ull nodes;
+    ull tasks;
+} __attribute__((aligned(64))) WorkerCounts;
+
+/*
+	one search from the root. the root split point is never cut off by
+	a fail high; cutting it off is how the search is stopped, and every
+	node below it sees that through Aborted(). workers count nodes and
+	tasks in their own slot and check the budget every NODES_PER_CHECK
+	nodes.
+*/
+typedef struct Search {
+    SplitPoint root;
+    double deadline;    // stop when Now() passes this, 0 for no limit
+    ull maxnodes;       // stop after about this many nodes, 0 for no limit
+    const EvalWeights *eval;   // 0 to count disks
+    ull salt;                  // eval's salt for table keys, 0 without
+    WorkerCounts counts[MAX_WORKERS];
+#ifndef NO_STATS
+    NodeStats stats;            // nodestats, summed at the end of every NegamaxRoot
+    ull iterations[MAX_PLY];    // nodes of the NegamaxRoot to each depth
+#endif
+#ifdef PROFILE
+    ull work, span, wall;       // cycles of the root searches, summed over iterations
+    ull movework[64], movespan[64];   // of each root move in the last one
+#endif
+} Search;
+
+#define NODES_PER_CHECK 4096
+
+// seconds on a monotonic clock
+static double Now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void InitSearch(Search *s, double seconds, ull maxnodes, const EvalWeights *eval) {
+    memset(s, 0, sizeof(*s));
+    s->root.search = s;
+    s->deadline = (seconds > 0) ? Now() + seconds : 0;
+    s->maxnodes = maxnodes;
+    s->eval = eval;
+    s->salt = eval ? eval->salt : 0;
+}
+
+static ull SearchNodes(const Search *s) {
+    ull n = 0;
+    for (int w = 0; w < MAX_WORKERS; w++) n += s->counts[w].nodes;
+    return n;
+}
+
+static ull SearchTasks(const Search *s) {
+    ull n = 0;
+    for (int w = 0; w < MAX_WORKERS; w++) n += s->counts[w].tasks;
+    return n;
+}
+
+static inline void CountNode(Search *s) {
+    ull n = ++s->counts[WorkerId()].nodes;
+    if ((n % NODES_PER_CHECK) == 0 && (s->deadline > 0 || s->maxnodes > 0)) {
+        if ((s->deadline > 0 && Now() > s->deadline) ||
+            (s->maxnodes > 0 && SearchNodes(s) >= s->maxnodes)) {
+            s->root.cutoff = 1;
+        }
+    }
+}
+
+/*
+	spawn policy: whether a node spawns its younger brothers or
+	searches them itself. a spawn pays off when the brothers hold
+	enough work to cover what stealing one costs, so a node spawns
+	when the log2 of the estimated nodes under its younger brothers is
+	at least spawn_work. the estimate takes the square root of the
+	mobility as the branching factor (alpha-beta with good ordering)
+	over the plies left or the empty squares, whichever run out first.
+
+	the open split points (nodes whose spawned brothers are not all
+	done) are the work idle workers can steal; when there are fewer
+	of them than workers, the bar drops by spawn_idle so the idle
+	workers get something. nodes spawn_depth or fewer plies from the
+	horizon never spawn. --spawn-depth=4 --spawn-work=0 is the fixed
+	CUTOFF_DEPTH of 4 this replaced.
+*/
+static int spawn_depth = 2;
+static int spawn_work = 9;
+static int spawn_idle = 3;
+static int spawn_workers = 1;    // workers of the runtime, set at startup
+
+typedef struct { volatile int count; } __attribute__((aligned(64))) PaddedInt;
+static PaddedInt open_splits;
+
+static inline int Log2(unsigned x) {
+    return 31 - __builtin_clz(x | 1);
+}
+
+// should a node depth plies from the horizon, with this many empty
+// squares and moves, spawn its younger brothers?
+static inline bool ShouldSpawn(int depth, int empties, int moves) {
+    if (depth <= spawn_depth) return false;
+    int plies = ((depth < empties) ? depth : empties) - 1;
+    int work = plies * Log2(moves) / 2 + Log2(moves - 1);
+    if (work >= spawn_work) return true;
+    return work >= spawn_work - spawn_idle && open_splits.count < spawn_workers;
+}
+
+// tasks spawned and nodes per task (counting the root as one), at verbosity 3
+static void PrintSpawnStats(const Search *s) {
+    ull tasks = SearchTasks(s);
+    printf("Spawned %llu tasks, %.0f nodes per task\n", tasks, (double)SearchNodes(s) / (tasks + 1));
+}
+
+#define INF_SCORE 9999999
+
+/*
+	a score and an 8-bit tag packed into one word, ordered by score
+	first and tag second, so workers can raise a (score, move) pair
+	with a single compare-and-swap.
+*/
+#define PACK_SCORE(score, tag) (((ull)((score) + INF_SCORE) << 8) | (ull)(tag))
+#define PACKED_SCORE(p) ((int)((p) >> 8) - INF_SCORE)
+#define PACKED_TAG(p) ((int)((p) & 0xff))
+
+// true if a split point on the path to the root has been cut off;
+// the caller's result will be thrown away
+static inline bool Aborted(const SplitPoint *sp) {
+    for (; sp; sp = sp->parent) {
+        if (sp->cutoff) return true;
+    }
+    return false;
+}
+
+static inline void AtomicMax(volatile int *x, int value) {
+    int old = *x;
+    while (value > old) {
+        if (__atomic_compare_exchange_n(x, &old, value, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+    }
+}
+
+static inline void AtomicMax(volatile ull *x, ull value) {
+    ull old = *x;
+    while (value > old) {
+        if (__atomic_compare_exchange_n(x, &old, value, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+    }
+}
+
+/*
+	timeline tracer, on for the searches of computer moves with
+	--trace=PREFIX. each worker appends events to its own ring of
+	TRACE_EVENTS, so recording takes no lock and a full ring keeps the
+	latest events. recorded are the slices of tasks (with their move,
+	the depth below it and the nodes the worker searched in them), of
+	root searches, and of split points on the worker that spawned their
+	tasks, spawning and waiting for them; and steals, tasks that start
+	on another worker than the one that spawned them. a slice goes to
+	the ring of the worker that ends it, which under Cilk may not be
+	the one that began it.
+
+	after each such move WriteTrace dumps the rings to PREFIX-N.json,
+	N counting the moves, in the Chrome trace event format (open it in
+	chrome://tracing or ui.perfetto.dev), adding the idle periods of
+	every worker: when it ran no task, or waited at a split point for
+	tasks other workers ran.
+*/
+enum { TRACE_SEARCH, TRACE_ROOT_MOVE, TRACE_TASK, TRACE_SOLVE_TASK, TRACE_SPLIT, TRACE_STEAL };
+static const char *trace_names[] = { "search", "root move", "task", "endgame task", "split", "steal" };
+
+typedef struct {
+    double start, end;   // seconds since trace_start; a steal has no length
+    ull nodes;           // the worker searched in the task
+    short kind;
+    short move;          // square of the task's move, NO_MOVE if none
+    short depth;         // plies below the move; for a steal, the worker it stole from
+    short unused;
+} TraceEvent;
+
+#define TRACE_EVENTS (1 << 16)
+
+typedef struct {
+    TraceEvent *events;   // allocated by the worker when it first records
+    ull count;            // events it ever recorded
+} __attribute__((aligned(64))) TraceRing;
+
+static TraceRing traces[MAX_WORKERS];
+static const char *trace_prefix = 0;   // --trace, 0 if not given
+static volatile bool tracing = false;  // during the search of a computer move with --trace
+static double trace_start;             // Now() when it began
+static int trace_moves = 0;            // moves traced so far
+
+static void RecordTrace(int kind, double start, double end, ull nodes, int move, int depth) {
+    TraceRing *r = &traces[WorkerId()];
+    if (!r->events) {
+        r->events = (TraceEvent *)malloc(TRACE_EVENTS * sizeof(TraceEvent));
+        if (!r->events) return;
+    }
+    TraceEvent *e = &r->events[r->count++ % TRACE_EVENTS];
+    e->start = start - trace_start;
+    e->end = end - trace_start;
+    e->nodes = nodes;
+    e->kind = kind;
+    e->move = move;
+    e->depth = depth;
+}
+
+// by start, and the longer of two slices that start together first
+static int CompareTraceEvents(const void *a, const void *b) {
+    const TraceEvent *x = (const TraceEvent *)a, *y = (const TraceEvent *)b;
+    if (x->start != y->start) return (x->start < y->start) ? -1 : 1;
+    if (x->end != y->end) return (x->end > y->end) ? -1 : 1;
+    return 0;
+}
+
+static void WriteIdle(FILE *f, int worker, double from, double to) {
+    if (to - from < 1e-6) return;
+    fprintf(f, ",\n{\"name\": \"idle\", \"cat\": \"idle\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+            "\"pid\": 1, \"tid\": %d}", from * 1e6, (to - from) * 1e6, worker);
+}
+
+/*
+	the events of one worker, sorted, and its idle periods up to end.
+	slices on a worker nest; the innermost open one says whether the
+	worker is busy (a task or search) or idle (a split point).
+*/
+static void WriteWorkerTrace(FILE *f, int worker, TraceEvent *events, ull n, double end) {
+    qsort(events, n, sizeof(TraceEvent), CompareTraceEvents);
+    const TraceEvent *open[64];
+    int depth = 0;
+    double cursor = 0;
+    for (ull i = 0; i <= n; i++) {
+        const TraceEvent *e = (i < n) ? &events[i] : 0;
+        double t = e ? e->start : end;
+        while (depth > 0 && open[depth - 1]->end <= t) {
+            if (open[depth - 1]->kind == TRACE_SPLIT) WriteIdle(f, worker, cursor, open[depth - 1]->end);
+            if (open[depth - 1]->end > cursor) cursor = open[depth - 1]->end;
+            depth--;
+        }
+        if (depth == 0 || open[depth - 1]->kind == TRACE_SPLIT) WriteIdle(f, worker, cursor, t);
+        if (t > cursor) cursor = t;
+        if (!e) break;
+
+        if (e->kind == TRACE_STEAL) {
+            fprintf(f, ",\n{\"name\": \"steal\", \"cat\": \"steal\", \"ph\": \"i\", \"s\": \"t\", \"ts\": %.3f, "
+                    "\"pid\": 1, \"tid\": %d, \"args\": {\"from\": %d}}", e->start * 1e6, worker, e->depth);
+            continue;
+        }
+        fprintf(f, ",\n{\"name\": \"%s", trace_names[e->kind]);
+        if (e->move != NO_MOVE) fprintf(f, " (%d, %d)", 8 - e->move / 8, 8 - e->move % 8);
+        fprintf(f, "\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %d",
+                trace_names[e->kind], e->start * 1e6, (e->end - e->start) * 1e6, worker);
+        if (e->kind != TRACE_SPLIT) {
+            fprintf(f, ", \"args\": {\"depth\": %d, \"nodes\": %llu}", e->depth, e->nodes);
+        }
+        fprintf(f, "}");
+        if (depth < 64) open[depth++] = e;
+    }
+}
+
+// dump the rings of every worker as the trace of move number, and empty them
+static void WriteTrace(int number) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s-%d.json", trace_prefix, number);
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+    } else {
+        double end = Now() - trace_start;
+        ull dropped = 0;
+        fprintf(f, "{\"traceEvents\": [\n{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, "
+                "\"args\": {\"name\": \"othello move %d\"}}", number);
+        for (int w = 0; w < MAX_WORKERS; w++) {
+            TraceRing *r = &traces[w];
+            if (w >= spawn_workers && r->count == 0) continue;
+            fprintf(f, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                    "\"args\": {\"name\": \"worker %d\"}}", w, w);
+            ull n = (r->count < TRACE_EVENTS) ? r->count : TRACE_EVENTS;
+            dropped += r->count - n;
+            WriteWorkerTrace(f, w, r->events, n, end);
+        }
+        fprintf(f, "\n], \"displayTimeUnit\": \"ms\", \"otherData\": {\"move\": %d, \"dropped\": %llu}}\n",
+                number, dropped);
+        fclose(f);
+    }
+    for (int w = 0; w < MAX_WORKERS; w++) traces[w].count = 0;
+}
+
+/*
+	work/span profiler, compiled in with -DPROFILE. every task the
+	search spawns (a younger brother, a root move, an endgame younger
+	brother) times itself in cycles. a split point sums the work of its
+	tasks and keeps the longest span, and the task that spawned them
+	adds both to its own serial cycles when it syncs: it waited for the
+	longest of them. the root search is a task itself, so each search
+	ends with its work (T1), its span (Tinf) and the parallelism T1/Tinf
+	of the spawn tree it built, as cilkview would report for the whole
+	program. spawning and stealing are not counted as work.
+
+	a thread's running task is kept in current_task. code after a sync
+	may run on another thread than the code before it, so every sync
+	puts it back.
+
+	the same hooks, at the start and end of tasks and split points,
+	record the timeline of the tracer.
+*/
+typedef struct TaskProfile {
+    ull start;     // cycles when the task began
+    ull nested;    // cycles it waited at syncs and in serial subtasks
+    ull work;      // of what it waited for
+    ull span;      // likewise
+    struct TaskProfile *outer;   // the task it runs within, for serial subtasks
+    double began;  // for the tracer: Now() when the task began,
+    int worker;    // on this worker (-1 if not tracing),
+    ull nodes;     // which had searched this many nodes
+} TaskProfile;
+
+#ifdef PROFILE
+static __thread TaskProfile *current_task = 0;
+#endif
+
+static inline ull Cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (ull)(Now() * 1e9);
+#endif
+}
+
+// begin t, a task searching below split point sp, spawned there if spawned is set
+static inline void BeginTask(TaskProfile *t, const SplitPoint *sp, bool spawned) {
+    t->worker = -1;
+    if (tracing) {
+        int w = WorkerId();
+        t->began = Now();
+        t->worker = w;
+        t->nodes = sp->search->counts[w].nodes;
+        if (spawned && sp->worker != w) RecordTrace(TRACE_STEAL, t->began, t->began, 0, NO_MOVE, sp->worker);
+    }
+#ifdef PROFILE
+    t->nested = t->work = t->span = 0;
+    t->outer = current_task;
+    current_task = t;
+    t->start = Cycles();
+#endif
+}
+
+// end t; its work and span are set in *work and *span
+static inline void EndTask(TaskProfile *t, ull *work, ull *span) {
+#ifdef PROFILE
+    ull own = Cycles() - t->start - t->nested;
+    *work = own + t->work;
+    *span = own + t->span;
+    current_task = t->outer;
+#else
+    (void) t, (void) work, (void) span;
+#endif
+}
+
+// record t, a task of search s of kind, for move with depth plies below it, on the timeline
+static inline void TraceTask(const TaskProfile *t, const Search *s, int kind, int move, int depth) {
+    if (t->worker >= 0) {
+        int w = WorkerId();
+        RecordTrace(kind, t->began, Now(), (w == t->worker) ? s->counts[w].nodes - t->nodes : 0, move, depth);
+    }
+}
+
+// end t, a task of kind spawned at split point sp for move, with depth plies below it
+static inline void EndSpawnedTask(TaskProfile *t, SplitPoint *sp, int kind, int move, int depth) {
+    TraceTask(t, sp->search, kind, move, depth);
+#ifdef PROFILE
+    ull work, span;
+    EndTask(t, &work, &span);
+    __sync_fetch_and_add(&sp->work, work);
+    AtomicMax(&sp->span, span);
+#endif
+}
+
+// end t, a task run serially within the one that was running when it began
+static inline void EndSerialTask(TaskProfile *t, ull *work, ull *span) {
+#ifdef PROFILE
+    ull wall = Cycles() - t->start;
+    EndTask(t, work, span);
+    t->outer->nested += wall;
+    t->outer->work += *work;
+    t->outer->span += *span;
+#else
+    (void) t, (void) work, (void) span;
+#endif
+}
+
+// begin t, the search of the root of s
+static inline void BeginRootSearch(TaskProfile *t, Search *s) {
+#ifdef PROFILE
+    memset(s->movework, 0, sizeof(s->movework));
+    memset(s->movespan, 0, sizeof(s->movespan));
+#endif
+    BeginTask(t, &s->root, false);
+}
+
+// end t, the search of the root of s to depth, and add it to the search's totals
+static inline void EndRootSearch(TaskProfile *t, Search *s, int depth) {
+    TraceTask(t, s, TRACE_SEARCH, NO_MOVE, depth);
+#ifdef PROFILE
+    ull wall = Cycles() - t->start, work, span;
+    EndTask(t, &work, &span);
+    s->work += work;
+    s->span += span;
+    s->wall += wall;
+#endif
+}
+
+// end t, the task that searched root move sq of s with depth plies below it:
+// serially if serial is set, else spawned at s->root
+static inline void EndRootMove(TaskProfile *t, Search *s, int sq, int depth, bool serial) {
+    TraceTask(t, s, TRACE_ROOT_MOVE, sq, depth);
+#ifdef PROFILE
+    ull work, span;
+    if (serial) {
+        EndSerialTask(t, &work, &span);
+    } else {
+        EndTask(t, &work, &span);
+        __sync_fetch_and_add(&s->root.work, work);
+        AtomicMax(&s->root.span, span);
+    }
+    s->movework[sq] = work;
+    s->movespan[sq] = span;
+#else
+    (void) serial;
+#endif
+}
+
+// the tasks of split point sp are about to be spawned
+static inline void BeginSplit(SplitPoint *sp) {
+    sp->worker = WorkerId();
+    if (tracing) sp->began = Now();
+#ifdef PROFILE
+    sp->work = sp->span = 0;
+    sp->task = current_task;
+    sp->start = Cycles();
+#endif
+}
+
+// the tasks of split point sp are done: charge them to the task that spawned them
+static inline void EndSplit(SplitPoint *sp) {
+    if (tracing && WorkerId() == sp->worker) RecordTrace(TRACE_SPLIT, sp->began, Now(), 0, NO_MOVE, 0);
+#ifdef PROFILE
+    current_task = sp->task;
+    if (current_task) {
+        current_task->nested += Cycles() - sp->start;
+        current_task->work += sp->work;
+        current_task->span += sp->span;
+    }
+#endif
+}
+
+#ifdef PROFILE
+// the speedup greedy scheduling guarantees on p workers, and at most gets
+static void SpeedupBounds(double work, double span, int p, double *lower, double *upper) {
+    *lower = work / (work / p + span);
+    *upper = (work / span < p) ? work / span : p;
+}
+
+/*
+	work, span and parallelism of search s at verbosity 3, the speedup
+	bounds they give on this run's workers and on 16 and 32, the
+	speedup the search achieved (work over elapsed cycles), and the
+	parallelism of every root move searched as a task in the last
+	iteration.
+*/
+static void PrintProfile(const Search *s) {
+    if (s->span == 0) return;
+    double lower, upper;
+    printf("Work %.1f Mcycles, span %.1f Mcycles, parallelism %.1f, achieved speedup %.1f\n",
+           s->work / 1e6, s->span / 1e6, (double)s->work / s->span,
+           s->wall ? (double)s->work / s->wall : 0.0);
+    int workers[3] = { spawn_workers, 16, 32 };
+    printf("Speedup bounds:");
+    for (int i = 0, any = 0; i < 3; i++) {
+        if (workers[i] < 2 || (i > 0 && workers[i] == spawn_workers)) continue;
+        SpeedupBounds(s->work, s->span, workers[i], &lower, &upper);
+        printf("%s %.1f-%.1f on %d", any++ ? "," : "", lower, upper, workers[i]);
+    }
+    printf("\n");
+    bool any = false;
+    for (int sq = 63; sq >= 0; sq--) {
+        if (s->movespan[sq] == 0) continue;
+        printf("%s (%d, %d) %.1f", any ? "," : "Root move parallelism:", 8 - sq / 8, 8 - sq % 8,
+               (double)s->movework[sq] / s->movespan[sq]);
+        any = true;
+    }
+    if (any) printf("\n");
+}
+#endif
+
+/*
+	move ordering. a node searches its moves in this order:
+	  - the best move stored in the transposition table
+	  - the two killer moves of this ply: moves that recently caused a
+	    cutoff in a sibling subtree. each worker keeps its own.
+	  - the rest by history score, shared by all workers and raised
+	    for a move whenever it causes a cutoff, plus a static prior
+	    for the square (corners first, X- and C-squares last).
+	at high remaining depth a node with no table move can also rank
+	its moves by a shallow search (--order-depth). the square priors
+	are kept small so history soon outweighs them.
+*/
+static const int square_prior[64] = {
+    25, -5,  2,  1,  1,  2, -5, 25,
+    -5,-10,  0,  0,  0,  0,-10, -5,
+     2,  0,  0,  0,  0,  0,  0,  2,
+     1,  0,  0,  0,  0,  0,  0,  1,
+     1,  0,  0,  0,  0,  0,  0,  1,
+     2,  0,  0,  0,  0,  0,  0,  2,
+    -5,-10,  0,  0,  0,  0,-10, -5,
+    25, -5,  2,  1,  1,  2, -5, 25
+};
+
+// closer to the horizon than this, sorting costs more than it saves:
+// such nodes try the table move and then go in square order
+#define ORDER_MIN_DEPTH 3
+
+#define HISTORY_MAX (1 << 24)
+#define TT_MOVE_ORDER     (1 << 30)
+#define KILLER_ORDER(k)   ((1 << 29) >> (k))
+
+static volatile int history[2][64];
+
+typedef struct { int move[MAX_PLY][2]; } __attribute__((aligned(64))) Killers;
+static Killers killers[MAX_WORKERS];
+
+// per remaining depth: nodes that beat alpha, and how often their
+// first move was the best one
+typedef struct {
+    ull nodes[MAX_PLY];
+    ull firstbest[MAX_PLY];
+} __attribute__((aligned(64))) OrderStats;
+static OrderStats orderstats[MAX_WORKERS];
+
+// remaining depth at which nodes without a table move order by a
+// shallow search, and the depth of that search; 0 turns it off
+static int order_search_depth = 0;
+#define ORDER_SEARCH_PLIES 2
+
+static void ClearOrdering(void) {
+    memset((void *)history, 0, sizeof(history));
+    for (int w = 0; w < MAX_WORKERS; w++) {
+        for (int ply = 0; ply < MAX_PLY; ply++) {
+            killers[w].move[ply][0] = killers[w].move[ply][1] = NO_MOVE;
+        }
+    }
+    memset(orderstats, 0, sizeof(orderstats));
+}
+
+/*
+	fill moveList with the moves in moves, best first, and return how
+	many there are. scores, if given, are extra ordering keys per square
+	that take precedence over everything but the table move.
+*/
+static int OrderMoves(ull moves, int color, int ttMove, int ply, const int *scores, int *moveList) {
+    int order[64];
+    const int *killer = (ply < MAX_PLY) ? killers[WorkerId()].move[ply] : 0;
+    int n = 0;
+    while (moves) {
+        int sq = __builtin_ctzll(moves);
+        int key;
+        if (sq == ttMove) {
+            key = TT_MOVE_ORDER;
+        } else if (scores) {
+            key = scores[sq];
+        } else if (killer && sq == killer[0]) {
+            key = KILLER_ORDER(0);
+        } else if (killer && sq == killer[1]) {
+            key = KILLER_ORDER(1);
+        } else {
+            key = history[color][sq] + square_prior[sq];
+        }
+        // insertion sort: there are rarely more than a dozen moves
+        int i = n++;
+        while (i > 0 && order[i - 1] < key) {
+            order[i] = order[i - 1];
+            moveList[i] = moveList[i - 1];
+            i--;
+        }
+        order[i] = key;
+        moveList[i] = sq;
+        moves &= moves - 1;
+    }
+    return n;
+}
+
+// sq caused a cutoff at a node depth plies from the horizon
+static void RecordCutoff(int color, int sq, int depth, int ply) {
+    if (ply < MAX_PLY) {
+        int *killer = killers[WorkerId()].move[ply];
+        if (killer[0] != sq) {
+            killer[1] = killer[0];
+            killer[0] = sq;
+        }
+    }
+    if (history[color][sq] < HISTORY_MAX) {
+        __atomic_fetch_add(&history[color][sq], depth * depth, __ATOMIC_RELAXED);
+    }
+}
+
+static void RecordFirstBest(int depth, bool first) {
+#ifndef NO_STATS
+    if (depth < MAX_PLY) {
+        OrderStats *st = &orderstats[WorkerId()];
+        st->nodes[depth]++;
+        st->firstbest[depth] += first;
+    }
+#else
+    (void) depth, (void) first;
+#endif
+}
+
+static void PrintOrderStats(void) {
+#ifndef NO_STATS
+    bool any = false;
+    for (int d = 1; d < MAX_PLY; d++) {
+        ull nodes = 0, firstbest = 0;
+        for (int w = 0; w < MAX_WORKERS; w++) {
+            nodes += orderstats[w].nodes[d];
+            firstbest += orderstats[w].firstbest[d];
+        }
+        if (nodes == 0) continue;
+        printf("%s d%d %.1f%%", any ? "," : "First move best:", d, 100.0 * firstbest / nodes);
+        any = true;
+    }
+    if (any) printf("\n");
+#endif
+}
+
+
+int Negamax(const Position &p, int color, int depth, int alpha, int beta, int ply, SplitPoint *sp);
+
+/*
+	search one of the younger children of split point sp: a null
+	window search against the current alpha first (PVS), and a full
+	window re-search only if the child might beat alpha.
+*/
+static void SearchYoungerBrother(const Position *p, int color, int sq, int depth, int ply, SplitPoint *sp) {
+    if (Aborted(sp)) return;
+
+    TaskProfile task;
+    BeginTask(&task, sp, true);
+    Position child;
+    MakeMove(p, color, sq, &child);
+    int alpha = sp->alpha;
+    int val = -Negamax(child, OTHERCOLOR(color), depth - 1, -alpha - 1, -alpha, ply + 1, sp);
+    if (val > alpha && val < sp->beta && !Aborted(sp)) {
+        val = -Negamax(child, OTHERCOLOR(color), depth - 1, -sp->beta, -alpha, ply + 1, sp);
+    }
+    EndSpawnedTask(&task, sp, TRACE_TASK, sq, depth - 1);
+    if (Aborted(sp)) return;
+
+    AtomicMax(&sp->best, PACK_SCORE(val, sq));
+    if (val > alpha) {
+        AtomicMax(&sp->alpha, val);
+        if (val >= sp->beta) sp->cutoff = 1;
+    }
+}
+
+// Parallel Negamax
+// Alpha-beta (principal variation search) Negamax returning the best
+// score for color, failing soft outside (alpha, beta).
+// depth is how many moves ahead to explore; ply is how many moves
+// this node is below the root.
+//
+// Young Brothers Wait: the first child is searched serially to get a
+// bound; if ShouldSpawn agrees the remaining children are then spawned
+// with that window and abandon their work if one of them fails high.
+// sp is the innermost split point above this node; when it or any
+// split point above it is cut off the return value is meaningless.
+//
+// The transposition table supplies a first move to try, and a cutoff
+// when it holds a bound for this position searched to exactly this
+// depth. Deeper entries would be stronger but would make the result
+// differ from a plain fixed-depth search.
+
+int Negamax(const Position &p, int color, int depth, int alpha, int beta, int ply, SplitPoint *sp) {
+    CountNode(sp->search);
+    NODE_STAT(plies[ply < MAX_PLY ? ply : MAX_PLY - 1]);
+    if (depth == 0) {
+        NODE_STAT(leaves);
+        return EvaluatePosition(p, color, sp->search->eval);
+    }
+
+    ull key = 0;
+    int ttMove = NO_MOVE;
+    if ((tt || cache) && depth >= TT_MIN_DEPTH) {
+        ull data, cached;
+        key = PositionKey(p, color) ^ sp->search->salt;
+        bool hit = tt && ProbeTT(key, &data);
+        bool old = hit && TT_GEN(data) != tt_generation;
+        if ((!hit || TT_DEPTH(data) != depth) && depth >= CACHE_MIN_DEPTH && ProbeCache(key, &cached) &&
+            (!hit || TT_DEPTH(cached) == depth)) {
+            data = cached;
+            hit = true;
+            old = false;
+        }
+        if (old) NODE_STAT(reused);
+        if (hit) {
+            ttMove = TT_MOVE(data);
+            if (TT_DEPTH(data) == depth) {
+                int score = TT_SCORE(data);
+                int bound = TT_BOUND(data);
+                if (bound == BOUND_EXACT ||
+                    (bound == BOUND_LOWER && score >= beta) ||
+                    (bound == BOUND_UPPER && score <= alpha)) {
+                    NODE_STAT(ttcuts);
+                    if (old) NODE_STAT(reusedcuts);
+                    return score;
+                }
+            }
+        }
+    }
+
+    ull moves = LegalMoves(p.board.disks[color], p.board.disks[OTHERCOLOR(color)]);
+    if (moves == 0) {
+        if (LegalMoves(p.board.disks[OTHERCOLOR(color)], p.board.disks[color]) == 0) {
+            NODE_STAT(terminals);
+            return p.count[color] - p.count[OTHERCOLOR(color)];   // game over
+        }
+        NODE_STAT(passes);
+        return -Negamax(p, OTHERCOLOR(color), depth - 1, -beta, -alpha, ply + 1, sp);
+    }
+
+    Position child;
+    int moveList[64];
+    int idx;
+    if (order_search_depth > 0 && depth >= order_search_depth &&
+        ttMove == NO_MOVE && (moves & (moves - 1))) {
+        int scores[64];
+        for (ull m = moves; m; m &= m - 1) {
+            int sq = __builtin_ctzll(m);
+            MakeMove(&p, color, sq, &child);
+            scores[sq] = -Negamax(child, OTHERCOLOR(color), ORDER_SEARCH_PLIES,
+                                  -INF_SCORE, INF_SCORE, ply + 1, sp);
+        }
+        idx = OrderMoves(moves, color, ttMove, ply, scores, moveList);
+    } else if (depth >= ORDER_MIN_DEPTH) {
+        idx = OrderMoves(moves, color, ttMove, ply, 0, moveList);
+    } else {
+        idx = 0;
+        if (ttMove != NO_MOVE && (moves & (0x1ULL << ttMove))) {
+            moveList[idx++] = ttMove;
+            moves ^= 0x1ULL << ttMove;
+        }
+        while (moves) {
+            moveList[idx++] = __builtin_ctzll(moves);
+            moves &= moves - 1;
+        }
+    }
+
+    // Eldest brother: full window, serial
+    int alphaOrig = alpha;
+    MakeMove(&p, color, moveList[0], &child);
+    int bestValue = -Negamax(child, OTHERCOLOR(color), depth - 1, -beta, -alpha, ply + 1, sp);
+    int bestSq = moveList[0];
+    if (bestValue > alpha) alpha = bestValue;
+
+    if (alpha >= beta || idx == 1 || Aborted(sp)) {
+        // nothing left to search
+    } else if (!ShouldSpawn(depth, p.empties, idx)) {
+        // too little work to be worth spawning
+        for (int i = 1; i < idx; i++) {
+            MakeMove(&p, color, moveList[i], &child);
+            int val = -Negamax(child, OTHERCOLOR(color), depth - 1, -alpha - 1, -alpha, ply + 1, sp);
+            if (val > alpha && val < beta) {
+                val = -Negamax(child, OTHERCOLOR(color), depth - 1, -beta, -alpha, ply + 1, sp);
+            }
+            if (Aborted(sp)) return bestValue;
+            if (val > bestValue) {
+                bestValue = val;
+                bestSq = moveList[i];
+                if (val > alpha) {
+                    alpha = val;
+                    if (alpha >= beta) break;
+                }
+            }
+        }
+    } else {
+        SplitPoint split;
+        split.cutoff = 0;
+        split.alpha = alpha;
+        split.best = PACK_SCORE(bestValue, bestSq);
+        split.beta = beta;
+        split.parent = sp;
+        split.search = sp->search;
+
+        sp->search->counts[WorkerId()].tasks += idx - 1;
+        __sync_fetch_and_add(&open_splits.count, 1);
+        const Position *pp = &p;
+        SplitPoint *psplit = &split;
+        BeginSplit(&split);
+        PAR_GROUP(tasks);
+        for (int i = 1; i < idx; i++) {
+            int sq = moveList[i];
+            PAR_SPAWN(tasks, SearchYoungerBrother(pp, color, sq, depth, ply, psplit));
+        }
+        PAR_SYNC(tasks);
+        EndSplit(&split);
+        __sync_fetch_and_sub(&open_splits.count, 1);
+
+        bestValue = PACKED_SCORE(split.best);
+        bestSq = PACKED_TAG(split.best);
+    }
+
+    if (Aborted(sp)) return bestValue;
+
+    if (bestValue > alphaOrig) {
+        RecordFirstBest(depth, bestSq == moveList[0]);
+        if (bestValue >= beta && depth >= ORDER_MIN_DEPTH) RecordCutoff(color, bestSq, depth, ply);
+    }
+    if (bestValue >= beta) {
+        NODE_STAT(cutoffs);
+        if (bestSq == moveList[0]) NODE_STAT(firstcuts);
+    }
+    if (key) {
+        int bound = (bestValue <= alphaOrig) ? BOUND_UPPER
+                  : (bestValue >= beta) ? BOUND_LOWER : BOUND_EXACT;
+        if (tt) StoreTT(key, bestValue, depth, bound, bestSq);
+        if (depth >= CACHE_MIN_DEPTH) StoreCache(key, bestValue, depth, bound, bestSq);
+    }
+    return bestValue;
+}
+
+/*
+	the root keeps its best (score, move rank) pair packed into one
+	word, where a move's rank is its position in square order. a higher
+	score wins; among equal scores the lower rank wins, which is the
+	move a left-to-right scan of the moves in square order would keep,
+	whatever order they are searched in.
+*/
+#define PACK_ROOT_BEST(score, rank) PACK_SCORE(score, 255 - (rank))
+#define ROOT_BEST_SCORE(p) PACKED_SCORE(p)
+#define ROOT_BEST_RANK(p) (255 - PACKED_TAG(p))
+
+// a move that ties the best so far still wins if it comes earlier in
+// square order, so it only has to reach alpha, not beat it
+static inline int RootAlpha(ull best, int rank) {
+    int alpha = ROOT_BEST_SCORE(best);
+    if (ROOT_BEST_RANK(best) > rank) alpha--;
+    return alpha;
+}
+
+static void SearchRootMove(const Position *p, int color, int depth, int sq, int rank,
+                           volatile ull *best, SplitPoint *root) {
+    TaskProfile task;
+    BeginTask(&task, root, true);
+    Position child;
+    MakeMove(p, color, sq, &child);
+
+    int alpha = RootAlpha(*best, rank);
+
+    int val = -Negamax(child, OTHERCOLOR(color), depth - 1, -alpha - 1, -alpha, 1, root);
+    if (val > alpha && !Aborted(root)) {
+        val = -Negamax(child, OTHERCOLOR(color), depth - 1, -INF_SCORE, -alpha, 1, root);
+    }
+    EndRootMove(&task, root->search, sq, depth - 1, false);
+    if (val <= alpha || Aborted(root)) return;
+
+    AtomicMax(best, PACK_ROOT_BEST(val, rank));
+}
+
+/*
+	root splitting across MPI ranks (built with -DWITH_MPI, run under
+	mpirun). every rank runs the program with the same options; rank 0
+	plays or analyzes as usual and the others wait in MpiServe for root
+	moves to search with their own workers and transposition tables.
+	a root search mpi_depth or more plies deep that can have the ranks
+	(one at a time; the others stay on rank 0) searches its first move
+	on rank 0, then hands out the rest one at a time: to every other
+	rank as it comes free, and to rank 0's workers, which take the next
+	one whenever they finish one. so ranks that draw small subtrees
+	just search more of them.
+
+	a rank gets the best (score, rank) so far with its move and tests
+	the move against it as SearchRootMove does. rank 0 sends every
+	improvement to the ranks still searching; one whose null window
+	test the new bound makes moot drops it and tests against the new
+	bound instead. on rank 0 a thread of its own, not a worker, does
+	the messaging while its workers search; on the others the main
+	thread searches and a thread listens for bounds. without WITH_MPI
+	there is only rank 0.
+*/
+static int mpi_rank = 0;
+static int mpi_depth = 6;
+
+#ifdef WITH_MPI
+static int mpi_ranks = 1;
+
+#define MPI_TAG_MOVE 1      // a root move to search: MpiMove
+#define MPI_TAG_BOUND 2     // a better best so far
+#define MPI_TAG_STOP 3      // the search was stopped; give up the move
+#define MPI_TAG_RESULT 4    // of a move: MpiResult
+#define MPI_TAG_QUIT 5      // leave MpiServe
+#define MPI_POLL_NS 50000   // between polls for messages
+
+#define MPI_WORDS(x) ((int)(sizeof(x) / sizeof(ull)))
+
+typedef struct {
+    ull disks[2];
+    ull color, depth, sq, rank;
+    ull best;     // PACK_ROOT_BEST of the best so far
+    ull eval;     // index into mpi_evals
+} MpiMove;
+
+typedef struct {
+    ull raised;   // the move beat the best, and best is its score
+    ull best;
+    ull nodes;
+} MpiResult;
+
+static const EvalWeights *mpi_evals[4];   // the evaluators a search may use, by index
+static volatile int mpi_busy;            // a root search has the other ranks
+
+static void MpiPause(void) {
+    struct timespec ts = { 0, MPI_POLL_NS };
+    nanosleep(&ts, 0);
+}
+
+static void MpiSendAll(const char *searching, int tag, ull word) {
+    for (int k = 1; k < mpi_ranks; k++) {
+        if (searching[k]) MPI_Send(&word, 1, MPI_UNSIGNED_LONG_LONG, k, tag, MPI_COMM_WORLD);
+    }
+}
+
+// the root moves after the first, shared by rank 0's workers and the other ranks
+typedef struct {
+    const Position *p;
+    int color, depth;
+    const int *moves;   // in search order
+    int nmoves;
+    ull legal;          // all the root moves, to rank them
+    int eval;
+    volatile int next;  // the next move to hand out
+    volatile ull *best;
+    Search *s;
+    ull nodes;          // searched by the other ranks
+} RootShare;
+
+static inline int RootRank(ull legal, int sq) {
+    return __builtin_popcountll(legal & ((0x1ULL << sq) - 1));
+}
+
+// hand the next move to rank k; false if there is none left
+static bool SendRootMove(RootShare *r, int k) {
+    int i = __sync_fetch_and_add(&r->next, 1);
+    if (i >= r->nmoves) return false;
+    int sq = r->moves[i];
+    MpiMove m = { { r->p->board.disks[X_BLACK], r->p->board.disks[O_WHITE] },
+                  (ull)r->color, (ull)r->depth, (ull)sq, (ull)RootRank(r->legal, sq),
+                  *r->best, (ull)r->eval };
+    MPI_Send(&m, MPI_WORDS(m), MPI_UNSIGNED_LONG_LONG, k, MPI_TAG_MOVE, MPI_COMM_WORLD);
+    return true;
+}
+
+// rank 0's messaging thread: keep the other ranks busy until the moves run out
+static void *DispatchRootMoves(void *arg) {
+    RootShare *r = (RootShare *)arg;
+    Search *s = r->s;
+    char *searching = (char *)calloc(mpi_ranks, 1);
+    int busy = 0;
+    for (int k = 1; k < mpi_ranks && SendRootMove(r, k); k++) {
+        searching[k] = 1;
+        busy++;
+    }
+    ull sent = *r->best;
+    bool stopped = false;
+    while (busy > 0) {
+        int flag;
+        MPI_Status status;
+        MPI_Iprobe(MPI_ANY_SOURCE, MPI_TAG_RESULT, MPI_COMM_WORLD, &flag, &status);
+        if (flag) {
+            MpiResult result;
+            int k = status.MPI_SOURCE;
+            MPI_Recv(&result, MPI_WORDS(result), MPI_UNSIGNED_LONG_LONG, k, MPI_TAG_RESULT,
+                     MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            r->nodes += result.nodes;
+            searching[k] = 0;
+            busy--;
+            if (stopped) continue;
+            if (result.raised) AtomicMax(r->best, result.best);
+            if (SendRootMove(r, k)) {
+                searching[k] = 1;
+                busy++;
+            }
+            continue;
+        }
+        // with rank 0's workers done, no one else checks the clock
+        if (s->deadline > 0 && Now() > s->deadline) s->root.cutoff = 1;
+        if (!stopped && Aborted(&s->root)) {
+            stopped = true;
+            MpiSendAll(searching, MPI_TAG_STOP, 0);
+        } else if (!stopped && *r->best != sent) {
+            sent = *r->best;
+            MpiSendAll(searching, MPI_TAG_BOUND, sent);
+        }
+        MpiPause();
+    }
+    free(searching);
+    return 0;
+}
+
+/*
+	search the root moves after the first across the ranks, or return
+	false if this search should not: too shallow, one rank, or another
+	search has them.
+*/
+static bool SearchRootMovesMpi(const Position *p, int color, int depth, const int *moves, int nmoves,
+                               ull legal, volatile ull *best, Search *s) {
+    int eval = 0;
+    while (eval < 4 && mpi_evals[eval] != s->eval) eval++;
+    if (mpi_ranks < 2 || depth < mpi_depth || nmoves == 0 || eval == 4) return false;
+    if (__sync_lock_test_and_set(&mpi_busy, 1)) return false;
+
+    RootShare r = { p, color, depth, moves, nmoves, legal, eval, 0, best, s, 0 };
+    pthread_t dispatcher;
+    pthread_create(&dispatcher, 0, DispatchRootMoves, &r);
+    for (;;) {
+        int i = __sync_fetch_and_add(&r.next, 1);
+        if (i >= nmoves || Aborted(&s->root)) break;
+        SearchRootMove(p, color, depth, moves[i], RootRank(legal, moves[i]), best, &s->root);
+    }
+    pthread_join(dispatcher, 0);
+    s->counts[WorkerId()].nodes += r.nodes;
+    __sync_lock_release(&mpi_busy);
+    return true;
+}
+
+// a root move being searched on a rank other than 0
+typedef struct {
+    Search s;
+    volatile ull best;
+    volatile int alpha;     // being tested with a null window, or INF_SCORE
+    volatile int stopped;
+    volatile int done;
+    int rank;
+} RemoteMove;
+
+// the thread that takes rank 0's bounds while a rank searches its move
+static void *ListenForBounds(void *arg) {
+    RemoteMove *m = (RemoteMove *)arg;
+    while (!m->done) {
+        int flag;
+        MPI_Status status;
+        MPI_Iprobe(0, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, &status);
+        if (!flag) {
+            MpiPause();
+            continue;
+        }
+        ull word;
+        MPI_Recv(&word, 1, MPI_UNSIGNED_LONG_LONG, 0, status.MPI_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        if (status.MPI_TAG == MPI_TAG_BOUND) {
+            AtomicMax(&m->best, word);
+            if (RootAlpha(word, m->rank) > m->alpha) m->s.root.cutoff = 1;
+        } else if (status.MPI_TAG == MPI_TAG_STOP) {
+            m->stopped = 1;
+            m->s.root.cutoff = 1;
+        }
+    }
+    return 0;
+}
+
+// SearchRootMove on a rank other than 0, starting over whenever the bound rises past its alpha
+static bool SearchRemoteMove(RemoteMove *m, const Board &b, int color, int depth, int sq, ull *best) {
+    Position p, child;
+    SetPosition(&p, b);
+    MakeMove(&p, color, sq, &child);
+    SplitPoint *root = &m->s.root;
+    for (;;) {
+        int alpha = RootAlpha(m->best, m->rank);
+        root->cutoff = 0;
+        m->alpha = alpha;
+        int val = -Negamax(child, OTHERCOLOR(color), depth - 1, -alpha - 1, -alpha, 1, root);
+        m->alpha = INF_SCORE;
+        if (m->stopped) return false;
+        if (root->cutoff) continue;
+        if (val <= alpha) return false;
+        val = -Negamax(child, OTHERCOLOR(color), depth - 1, -INF_SCORE, -alpha, 1, root);
+        if (m->stopped) return false;
+        if (root->cutoff) continue;
+        *best = PACK_ROOT_BEST(val, m->rank);
+        return true;
+    }
+}
+
+// ranks other than 0: search the moves rank 0 sends until it says to quit
+static int MpiServe(void) {
+    RemoteMove *m = (RemoteMove *)malloc(sizeof(RemoteMove));
+    for (;;) {
+        MpiMove move;
+        MPI_Status status;
+        MPI_Recv(&move, MPI_WORDS(move), MPI_UNSIGNED_LONG_LONG, 0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+        if (status.MPI_TAG == MPI_TAG_QUIT) break;
+        if (status.MPI_TAG != MPI_TAG_MOVE) continue;   // a bound or stop that came after the result
+
+        Board b = { { move.disks[X_BLACK], move.disks[O_WHITE] } };
+        InitSearch(&m->s, 0, 0, mpi_evals[move.eval]);
+        m->best = move.best;
+        m->alpha = INF_SCORE;
+        m->stopped = 0;
+        m->done = 0;
+        m->rank = (int)move.rank;
+        pthread_t listener;
+        pthread_create(&listener, 0, ListenForBounds, m);
+        MpiResult result = { 0, 0, 0 };
+        ParallelRun([&] {
+            result.raised = SearchRemoteMove(m, b, (int)move.color, (int)move.depth, (int)move.sq, &result.best);
+        });
+        m->done = 1;
+        pthread_join(listener, 0);
+        result.nodes = SearchNodes(&m->s);
+        MPI_Send(&result, MPI_WORDS(result), MPI_UNSIGNED_LONG_LONG, 0, MPI_TAG_RESULT, MPI_COMM_WORLD);
+    }
+    free(m);
+    return 0;
+}
+
+static void MpiFinish(void) {
+    if (mpi_rank == 0) {
+        for (int k = 1; k < mpi_ranks; k++) MPI_Send(0, 0, MPI_UNSIGNED_LONG_LONG, k, MPI_TAG_QUIT, MPI_COMM_WORLD);
+    }
+    MPI_Finalize();
+}
+
+// rank 0's messaging thread calls MPI while its main thread does not
+static bool MpiInit(int *argc, char ***argv) {
+    int provided;
+    MPI_Init_thread(argc, argv, MPI_THREAD_SERIALIZED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &mpi_ranks);
+    atexit(MpiFinish);
+    if (provided < MPI_THREAD_SERIALIZED) {
+        if (mpi_rank == 0) fprintf(stderr, "the MPI library does not support MPI_THREAD_SERIALIZED\n");
+        return false;
+    }
+    return true;
+}
+#else
+static inline bool SearchRootMovesMpi(const Position *, int, int, const int *, int, ull, volatile ull *, Search *) {
+    return false;
+}
+#endif
+
+// Define a "root" function that enumerates moves, sand then picks the best index.
+// The first move in search order is searched with a full window; the
+// others are spawned with null windows against the best score so far.
+// The result is the same move and score a full-width search of every
+// root move would pick.
+// If s is stopped before the search completes, the result is meaningless.
+static int SearchRoot(const Board &b, int color, int depth, Search *s, Move *bestMove) {
+    Position p;
+    SetPosition(&p, b);
+    Board legalMoves;
+    int numMoves = EnumerateLegalMoves(b, color, &legalMoves);
+    if (numMoves == 0) {
+        bestMove->row = 0;
+        bestMove->col = 0;
+        return -Negamax(p, OTHERCOLOR(color), depth - 1, -INF_SCORE, INF_SCORE, 1, &s->root);
+    }
+
+    ull moves = legalMoves.disks[color];
+    ull key = 0;
+    ull data;
+    int ttMove = NO_MOVE;
+    if (tt || cache) {
+        key = PositionKey(p, color) ^ s->salt;
+        if (tt && ProbeTT(key, &data)) ttMove = TT_MOVE(data);
+        if (ProbeCache(key, &data)) {
+            // a search to this depth in this or an earlier run
+            if (TT_DEPTH(data) == depth && TT_BOUND(data) == BOUND_EXACT &&
+                TT_MOVE(data) != NO_MOVE && (moves & (0x1ULL << TT_MOVE(data)))) {
+                bestMove->row = 8 - (TT_MOVE(data) / 8);
+                bestMove->col = 8 - (TT_MOVE(data) % 8);
+                return TT_SCORE(data);
+            }
+            if (ttMove == NO_MOVE) ttMove = TT_MOVE(data);
+        }
+    }
+
+    TaskProfile task, first;
+    BeginRootSearch(&task, s);
+    int moveList[64];
+    int idx = OrderMoves(moves, color, ttMove, 0, 0, moveList);
+
+    Position child;
+    BeginTask(&first, &s->root, false);
+    MakeMove(&p, color, moveList[0], &child);
+    int firstVal = -Negamax(child, OTHERCOLOR(color), depth - 1, -INF_SCORE, INF_SCORE, 1, &s->root);
+    EndRootMove(&first, s, moveList[0], depth - 1, true);
+    volatile ull best = PACK_ROOT_BEST(firstVal, __builtin_popcountll(moves & ((0x1ULL << moveList[0]) - 1)));
+
+    s->counts[WorkerId()].tasks += idx - 1;
+    __sync_fetch_and_add(&open_splits.count, 1);
+    const Position *pp = &p;
+    volatile ull *pbest = &best;
+    SplitPoint *root = &s->root;
+    BeginSplit(root);
+    if (!SearchRootMovesMpi(pp, color, depth, moveList + 1, idx - 1, moves, pbest, s)) {
+        PAR_GROUP(tasks);
+        for (int i = 1; i < idx; i++) {
+            int sq = moveList[i];
+            int rank = __builtin_popcountll(moves & ((0x1ULL << sq) - 1));
+            PAR_SPAWN(tasks, SearchRootMove(pp, color, depth, sq, rank, pbest, root));
+        }
+        PAR_SYNC(tasks);
+    }
+    EndSplit(root);
+    EndRootSearch(&task, s, depth);
+    __sync_fetch_and_sub(&open_splits.count, 1);
+
+    // the rank of the best move in square order
+    int rank = ROOT_BEST_RANK(best);
+    while (rank--) moves &= moves - 1;
+    int bestSq = __builtin_ctzll(moves);
+
+    if (key && !Aborted(&s->root)) {
+        if (tt) StoreTT(key, ROOT_BEST_SCORE(best), depth, BOUND_EXACT, bestSq);
+        StoreCache(key, ROOT_BEST_SCORE(best), depth, BOUND_EXACT, bestSq);
+    }
+    bestMove->row = 8 - (bestSq / 8);
+    bestMove->col = 8 - (bestSq % 8);
+    return ROOT_BEST_SCORE(best);
+}
+
+// SearchRoot, then the workers' statistics so far summed into s
+int NegamaxRoot(const Board &b, int color, int depth, Search *s, Move *bestMove) {
+#ifdef NO_STATS
+    return SearchRoot(b, color, depth, s, bestMove);
+#else
+    ull before = SearchNodes(s);
+    int score = SearchRoot(b, color, depth, s, bestMove);
+    if (depth < MAX_PLY) s->iterations[depth] = SearchNodes(s) - before;
+    SumNodeStats(&s->stats);
+    return score;
+#endif
+}
+
+/*
+	iterative deepening: search to depth 1, 2, ... maxdepth until the
+	time (seconds) or node budget is spent, then return the move and
+	score of the deepest search that completed. a budget of 0 means no
+	limit. depth 1 always runs to completion so there is always a move.
+	*depthReached is set to the depth of the returned result.
+*/
+int SearchIterative(const Board &b, int color, int maxdepth, double seconds, ull maxnodes,
+                    const EvalWeights *eval, Search *s, Move *bestMove, int *depthReached) {
+    double start = Now();
+    int bestScore = 0;
+    *depthReached = 0;
+
+    InitSearch(s, 0, 0, eval);
+    for (int depth = 1; depth <= maxdepth; depth++) {
+        Move m;
+        int score = NegamaxRoot(b, color, depth, s, &m);
+        if (s->root.cutoff) break;
+
+        *bestMove = m;
+        bestScore = score;
+        *depthReached = depth;
+
+        // the next depth costs several times this one; don't start it
+        // if it has no chance to finish
+        double elapsed = Now() - start;
+        if (seconds > 0 && elapsed > seconds / 2) break;
+        if (maxnodes > 0 && SearchNodes(s) > maxnodes / 2) break;
+        if (depth == 1) {
+            s->deadline = (seconds > 0) ? start + seconds : 0;
+            s->maxnodes = maxnodes;
+        }
+    }
+    return bestScore;
+}
+
+/*
+	exact endgame solver. once few enough squares are empty the tree
+	is small enough to search to the end of the game, and the score is
+	the final disk difference (what DiskDifference returns at the end
+	of the game). it can search for the exact score, or only for
+	win/loss/draw with a (-1, 1) window, which is much cheaper.
+
+	the solver works on (mine, theirs) bitboard pairs. from
+	ENDGAME_SORT_EMPTIES up, moves are generated and sorted fastest
+	first: the reply that leaves the opponent the fewest moves is tried
+	first, ahead of moves into regions with an even number of empties.
+	below that, the empty squares are tried directly, those in regions
+	with an odd number of empties first (parity), and the last three
+	empties have their own unrolled solvers. above ENDGAME_SPLIT_EMPTIES
+	younger brothers are spawned as in Negamax.
+
+	solved bounds go into the transposition table at depth SOLVED_DEPTH.
+	they hold however deep a later search is, but Negamax only takes
+	cutoffs at its own depth, so it just uses their moves.
+*/
+static int endgame_empties = 0;   // solve exactly at this many empties or fewer; 0 is off
+static int endgame_wld = 0;       // win/loss/draw only
+
+#define ENDGAME_SPLIT_EMPTIES 12
+#define ENDGAME_TT_EMPTIES 8
+#define ENDGAME_SORT_EMPTIES 6
+#define SOLVED_DEPTH 255
+
+// the board split into four 4x4 regions
+static const ull quadrants[4] = {
+    0xF0F0F0F000000000ULL, 0x0F0F0F0F00000000ULL,
+    0x00000000F0F0F0F0ULL, 0x000000000F0F0F0FULL
+};
+
+// the empty squares in regions with an odd number of empties
+static inline ull OddRegions(ull empty) {
+    ull odd = 0ULL;
+    for (int q = 0; q < 4; q++) {
+        if (__builtin_popcountll(empty & quadrants[q]) & 1) odd |= quadrants[q];
+    }
+    return empty & odd;
+}
+
+static inline int FinalScore(ull me, ull opp) {
+    return __builtin_popcountll(me) - __builtin_popcountll(opp);
+}
+
+// one empty square, sq: whoever can move there does, else the game ends
+static inline int Solve1(ull me, ull opp, int sq) {
+    int score = FinalScore(me, opp);
+    ull flips = FlipMask(sq, me, opp);
+    if (flips) return score + 2 * __builtin_popcountll(flips) + 1;
+    flips = FlipMask(sq, opp, me);
+    if (flips) return score - 2 * __builtin_popcountll(flips) - 1;
+    return score;
+}
+
+static int Solve2(ull me, ull opp, int alpha, int beta, int sq1, int sq2, int passed, Search *s) {
+    CountNode(s);
+    int bestValue = -INF_SCORE;
+    ull flips = FlipMask(sq1, me, opp);
+    if (flips) {
+        bestValue = -Solve1(opp ^ flips, me ^ flips ^ (0x1ULL << sq1), sq2);
+        if (bestValue >= beta) return bestValue;
+    }
+    flips = FlipMask(sq2, me, opp);
+    if (flips) {
+        int val = -Solve1(opp ^ flips, me ^ flips ^ (0x1ULL << sq2), sq1);
+        if (val > bestValue) bestValue = val;
+    }
+    if (bestValue == -INF_SCORE) {
+        if (passed) return FinalScore(me, opp);
+        return -Solve2(opp, me, -beta, -alpha, sq1, sq2, 1, s);
+    }
+    return bestValue;
+}
+
+static int Solve3(ull me, ull opp, int alpha, int beta, int sq1, int sq2, int sq3, int passed, Search *s) {
+    CountNode(s);
+    int bestValue = -INF_SCORE;
+    ull flips = FlipMask(sq1, me, opp);
+    if (flips) {
+        bestValue = -Solve2(opp ^ flips, me ^ flips ^ (0x1ULL << sq1), -beta, -alpha, sq2, sq3, 0, s);
+        if (bestValue >= beta) return bestValue;
+        if (bestValue > alpha) alpha = bestValue;
+    }
+    flips = FlipMask(sq2, me, opp);
+    if (flips) {
+        int val = -Solve2(opp ^ flips, me ^ flips ^ (0x1ULL << sq2), -beta, -alpha, sq1, sq3, 0, s);
+        if (val > bestValue) {
+            if (val >= beta) return val;
+            bestValue = val;
+            if (val > alpha) alpha = val;
+        }
+    }
+    flips = FlipMask(sq3, me, opp);
+    if (flips) {
+        int val = -Solve2(opp ^ flips, me ^ flips ^ (0x1ULL << sq3), -beta, -alpha, sq1, sq2, 0, s);
+        if (val > bestValue) bestValue = val;
+    }
+    if (bestValue == -INF_SCORE) {
+        if (passed) return FinalScore(me, opp);
+        return -Solve3(opp, me, -beta, -alpha, sq1, sq2, sq3, 1, s);
+    }
+    return bestValue;
+}
+
+// few empties: try the empty squares directly, odd regions first
+static int SolveShallow(ull me, ull opp, int alpha, int beta, int passed, Search *s) {
+    ull empty = ~(me | opp);
+    ull odd = OddRegions(empty);
+    int sqs[ENDGAME_SORT_EMPTIES];
+    int n = 0;
+    for (ull e = odd; e; e &= e - 1) sqs[n++] = __builtin_ctzll(e);
+    for (ull e = empty & ~odd; e; e &= e - 1) sqs[n++] = __builtin_ctzll(e);
+
+    switch (n) {
+    case 0: return FinalScore(me, opp);
+    case 1: return Solve1(me, opp, sqs[0]);
+    case 2: return Solve2(me, opp, alpha, beta, sqs[0], sqs[1], passed, s);
+    case 3: return Solve3(me, opp, alpha, beta, sqs[0], sqs[1], sqs[2], passed, s);
+    }
+
+    CountNode(s);
+    int bestValue = -INF_SCORE;
+    for (int i = 0; i < n; i++) {
+        ull flips = FlipMask(sqs[i], me, opp);
+        if (!flips) continue;
+        int val = -SolveShallow(opp ^ flips, me ^ flips ^ (0x1ULL << sqs[i]), -beta, -alpha, 0, s);
+        if (val > bestValue) {
+            if (val >= beta) return val;
+            bestValue = val;
+            if (val > alpha) alpha = val;
+        }
+    }
+    if (bestValue == -INF_SCORE) {
+        if (passed) return FinalScore(me, opp);
+        return -SolveShallow(opp, me, -beta, -alpha, 1, s);
+    }
+    return bestValue;
+}
+
+static int SolveDeep(ull me, ull opp, int color, int alpha, int beta, int passed,
+                     SplitPoint *sp, int *bestMove);
+
+static void SolveYoungerBrother(ull me, ull opp, int color, int sq, SplitPoint *sp) {
+    if (Aborted(sp)) return;
+
+    TaskProfile task;
+    BeginTask(&task, sp, true);
+    ull flips = FlipMask(sq, me, opp);
+    ull childMe = opp ^ flips, childOpp = me ^ flips ^ (0x1ULL << sq);
+    int alpha = sp->alpha;
+    int val = -SolveDeep(childMe, childOpp, OTHERCOLOR(color), -alpha - 1, -alpha, 0, sp, 0);
+    if (val > alpha && val < sp->beta && !Aborted(sp)) {
+        val = -SolveDeep(childMe, childOpp, OTHERCOLOR(color), -sp->beta, -alpha, 0, sp, 0);
+    }
+    EndSpawnedTask(&task, sp, TRACE_SOLVE_TASK, sq, 63 - __builtin_popcountll(me | opp));
+    if (Aborted(sp)) return;
+
+    AtomicMax(&sp->best, PACK_SCORE(val, sq));
+    if (val > alpha) {
+        AtomicMax(&sp->alpha, val);
+        if (val >= sp->beta) sp->cutoff = 1;
+    }
+}
+
+// many empties: generate, sort fastest first, and split like Negamax.
+// color is only needed to hash the position. if bestMove is given,
+// the best move is stored there (this is how the root is searched).
+static int SolveDeep(ull me, ull opp, int color, int alpha, int beta, int passed,
+                     SplitPoint *sp, int *bestMove) {
+    int empties = 64 - __builtin_popcountll(me | opp);
+    if (empties <= ENDGAME_SORT_EMPTIES && !bestMove) {
+        return SolveShallow(me, opp, alpha, beta, passed, sp->search);
+    }
+    CountNode(sp->search);
+
+    ull key = 0;
+    int ttMove = NO_MOVE;
+    if (tt && empties >= ENDGAME_TT_EMPTIES) {
+        Board b;
+        ull data;
+        b.disks[color] = me;
+        b.disks[OTHERCOLOR(color)] = opp;
+        key = HashBoard(b, color);
+        if (ProbeTT(key, &data)) {
+            ttMove = TT_MOVE(data);
+            if (TT_DEPTH(data) == SOLVED_DEPTH && !bestMove) {
+                int score = TT_SCORE(data);
+                int bound = TT_BOUND(data);
+                if (bound == BOUND_EXACT ||
+                    (bound == BOUND_LOWER && score >= beta) ||
+                    (bound == BOUND_UPPER && score <= alpha)) {
+                    return score;
+                }
+            }
+        }
+    }
+
+    ull moves = LegalMoves(me, opp);
+    if (moves == 0) {
+        if (passed || LegalMoves(opp, me) == 0) return FinalScore(me, opp);
+        return -SolveDeep(opp, me, OTHERCOLOR(color), -beta, -alpha, 1, sp, 0);
+    }
+
+    // fastest first: fewest replies, then odd regions
+    int moveList[64], order[64];
+    ull odd = OddRegions(~(me | opp));
+    int n = 0;
+    for (; moves; moves &= moves - 1) {
+        int sq = __builtin_ctzll(moves);
+        ull flips = FlipMask(sq, me, opp);
+        int rank = -2 * __builtin_popcountll(LegalMoves(opp ^ flips, me ^ flips ^ (0x1ULL << sq)));
+        if (odd & (0x1ULL << sq)) rank++;
+        if (sq == ttMove) rank = INF_SCORE;
+        int i = n++;
+        while (i > 0 && order[i - 1] < rank) {
+            order[i] = order[i - 1];
+            moveList[i] = moveList[i - 1];
+            i--;
+        }
+        order[i] = rank;
+        moveList[i] = sq;
+    }
+
+    // Eldest brother: full window, serial
+    int alphaOrig = alpha;
+    ull flips = FlipMask(moveList[0], me, opp);
+    int bestValue = -SolveDeep(opp ^ flips, me ^ flips ^ (0x1ULL << moveList[0]), OTHERCOLOR(color),
+                               -beta, -alpha, 0, sp, 0);
+    int bestSq = moveList[0];
+    if (bestValue > alpha) alpha = bestValue;
+
+    if (alpha >= beta || n == 1 || Aborted(sp)) {
+        // nothing left to search
+    } else if (empties <= ENDGAME_SPLIT_EMPTIES) {
+        for (int i = 1; i < n; i++) {
+            int sq = moveList[i];
+            flips = FlipMask(sq, me, opp);
+            ull childMe = opp ^ flips, childOpp = me ^ flips ^ (0x1ULL << sq);
+            int val = -SolveDeep(childMe, childOpp, OTHERCOLOR(color), -alpha - 1, -alpha, 0, sp, 0);
+            if (val > alpha && val < beta) {
+                val = -SolveDeep(childMe, childOpp, OTHERCOLOR(color), -beta, -alpha, 0, sp, 0);
+            }
+            if (Aborted(sp)) return bestValue;
+            if (val > bestValue) {
+                bestValue = val;
+                bestSq = sq;
+                if (val > alpha) {
+                    alpha = val;
+                    if (alpha >= beta) break;
+                }
+            }
+        }
+    } else {
+        SplitPoint split;
+        split.cutoff = 0;
+        split.alpha = alpha;
+        split.best = PACK_SCORE(bestValue, bestSq);
+        split.beta = beta;
+        split.parent = sp;
+        split.search = sp->search;
+
+        SplitPoint *psplit = &split;
+        BeginSplit(&split);
+        PAR_GROUP(tasks);
+        for (int i = 1; i < n; i++) {
+            int sq = moveList[i];
+            PAR_SPAWN(tasks, SolveYoungerBrother(me, opp, color, sq, psplit));
+        }
+        PAR_SYNC(tasks);
+        EndSplit(&split);
+
+        bestValue = PACKED_SCORE(split.best);
+        bestSq = PACKED_TAG(split.best);
+    }
+
+    if (Aborted(sp)) return bestValue;
+
+    if (key) {
+        int bound = (bestValue <= alphaOrig) ? BOUND_UPPER
+                  : (bestValue >= beta) ? BOUND_LOWER : BOUND_EXACT;
+        StoreTT(key, bestValue, SOLVED_DEPTH, bound, bestSq);
+    }
+    if (bestMove) *bestMove = bestSq;
+    return bestValue;
+}
+
+/*
+	solve the position for color to the end of the game. returns the
+	final disk difference with best play, or with endgame_wld only its
+	sign (1 win, 0 draw, -1 loss). a pass is the move (0, 0).
+*/
+int SolveEndgame(const Board &b, int color, Search *s, Move *bestMove) {
+    int alpha = endgame_wld ? -1 : -INF_SCORE;
+    int beta = endgame_wld ? 1 : INF_SCORE;
+    int bestSq = NO_MOVE;
+    TaskProfile task;
+    BeginRootSearch(&task, s);
+    int score = SolveDeep(b.disks[color], b.disks[OTHERCOLOR(color)], color,
+                          alpha, beta, 0, &s->root, &bestSq);
+    EndRootSearch(&task, s, 64 - __builtin_popcountll(b.disks[X_BLACK] | b.disks[O_WHITE]));
+    if (bestSq == NO_MOVE) {
+        // color has to pass
+        bestMove->row = 0;
+        bestMove->col = 0;
+    } else {
+        bestMove->row = 8 - (bestSq / 8);
+        bestMove->col = 8 - (bestSq % 8);
+    }
+    if (endgame_wld) score = (score > 0) - (score < 0);
+    return score;
+}
+
+/*
+	opening book: positions near the start with the move and score of
+	a deep search, so the first moves of a game need not be searched.
+	the book file is a header followed by the entries sorted by key,
+	and is mapped into memory as it is: opening it is an mmap, and a
+	probe is one interpolation search, keys being hashes spread evenly
+	over 64 bits.
+
+	positions symmetric to each other share one entry: the key is a
+	hash of the least of the 8 images of the board (CanonicalBoard) and
+	the side to move, and the move is a square on that image.
+
+	    char  magic[8]            "OTHBOOK1"
+	    int64 count
+	    BookEntry entry[count]    by increasing key
+*/
+typedef struct {
+    ull key;
+    short score;
+    unsigned char move;     // square on the canonical board
+    unsigned char depth;    // of the search that chose it
+    int unused;
+} BookEntry;
+
+static const char book_magic[8] = { 'O', 'T', 'H', 'B', 'O', 'O', 'K', '1' };
+#define BOOK_HEADER 16
+
+static const BookEntry *book = 0;   // the entries of the mapped book, 0 without
+static ull book_count = 0;
+static void *book_map = 0;
+static size_t book_size = 0;
+
+/*
+	the least image of b under the 8 symmetries; *symmetry, if given,
+	is set to the sym that Transform maps b to it with.
+*/
+static Board CanonicalBoard(const Board &b, int *symmetry) {
+    Board best = b;
+    int bestSym = 0;
+    for (int sym = 1; sym < 8; sym++) {
+        Board t = { { Transform(b.disks[X_BLACK], sym), Transform(b.disks[O_WHITE], sym) } };
+        if (t.disks[X_BLACK] < best.disks[X_BLACK] ||
+            (t.disks[X_BLACK] == best.disks[X_BLACK] && t.disks[O_WHITE] < best.disks[O_WHITE])) {
+            best = t;
+            bestSym = sym;
+        }
+    }
+    if (symmetry) *symmetry = bestSym;
+    return best;
+}
+
+// the splitmix64 finalizer
+static inline ull Mix64(ull x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// the book key of a canonical board with color to move
+static inline ull BookKey(const Board &canonical, int color) {
+    return Mix64(canonical.disks[X_BLACK] ^ Mix64(canonical.disks[O_WHITE] + color + 1));
+}
+
+static const BookEntry *ProbeBook(ull key) {
+    ull lo = 0, hi = book_count;   // the entry is in [lo, hi) if anywhere
+    while (lo < hi) {
+        ull first = book[lo].key, last = book[hi - 1].key;
+        if (key < first || key > last) return 0;
+        ull mid = lo;
+        if (last > first) mid += (ull)((double)(key - first) / (double)(last - first) * (hi - 1 - lo));
+        if (book[mid].key == key) return &book[mid];
+        if (book[mid].key < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return 0;
+}
+
+/*
+	the book move for color at b, if the book has one from a search at
+	least mindepth deep; *score and *depth are set to its score and
+	depth.
+*/
+static int BookMove(const Board &b, int color, int mindepth, Move *m, int *score, int *depth) {
+    if (!book) return 0;
+    int sym;
+    Board canonical = CanonicalBoard(b, &sym);
+    const BookEntry *e = ProbeBook(BookKey(canonical, color));
+    if (!e || e->depth < mindepth) return 0;
+
+    // the legal move that sym maps onto the book's square
+    for (ull moves = LegalMoves(b.disks[color], b.disks[OTHERCOLOR(color)]); moves; moves &= moves - 1) {
+        int sq = __builtin_ctzll(moves);
+        if (Transform(0x1ULL << sq, sym) == (0x1ULL << e->move)) {
+            m->row = 8 - (sq / 8);
+            m->col = 8 - (sq % 8);
+            *score = e->score;
+            *depth = e->depth;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void CloseBook(void) {
+    if (book_map) munmap(book_map, book_size);
+    book = 0;
+    book_map = 0;
+    book_count = 0;
+}
+
+// map the book in path; returns 0 if it cannot be read
+static int OpenBook(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return 0;
+    }
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= BOOK_HEADER) {
+        map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    ull count = 0;
+    if (map != MAP_FAILED) memcpy(&count, (char *)map + 8, sizeof(count));
+    if (map == MAP_FAILED || memcmp(map, book_magic, 8) != 0 ||
+        (ull)st.st_size != BOOK_HEADER + count * sizeof(BookEntry)) {
+        fprintf(stderr, "%s: not an opening book\n", path);
+        if (map != MAP_FAILED) munmap(map, st.st_size);
+        return 0;
+    }
+    CloseBook();
+    book_map = map;
+    book_size = st.st_size;
+    book_count = count;
+    book = (const BookEntry *)((char *)map + BOOK_HEADER);
+    return 1;
+}
+
+/*
+	a player: a human, or a computer with its search depth, its
+	per-move budget and its evaluation. a budget of 0 means no limit,
+	in which case the computer searches straight to depth.
+*/
+typedef struct {
+    char type;          // 'h'uman or 'c'omputer, 0 to ask
+    int depth;          // 0 to ask
+    double seconds;     // per-move time budget
+    ull nodes;          // per-move node budget
+    const EvalWeights *eval;   // 0 to count disks
+} Player;
+
+/*
+	how much a game prints: 0 only a summary line at the end, 1 a
+	line per computer move, 2 (the default) also the flips, the search
+	statistics and the board after every move.
+*/
+static int verbosity = 2;
+
+#ifndef NO_STATS
+// where every searched computer move's statistics go as a JSON line (--stats), 0 for nowhere
+static FILE *statsout = 0;
+#endif
+
+// the search time of every computer move of a game, in order
+#define MAX_GAME_MOVES 64
+
+typedef struct {
+    int nmoves;
+    int color[MAX_GAME_MOVES];
+    double seconds[MAX_GAME_MOVES];
+} GameLog;
+
+/*
+	search b for color the way player does: solve it exactly in the
+	endgame, else deepen iteratively under the per-move budget if there
+	is one, else search to depth. *depthReached is set to the depth
+	searched (the number of empties when solved).
+*/
+int SearchPosition(const Board &b, int color, const Player *player, Search *s, Move *bestMove,
+                   int *depthReached) {
+    int empties = 64 - __builtin_popcountll(b.disks[X_BLACK] | b.disks[O_WHITE]);
+    if (empties <= endgame_empties) {
+        InitSearch(s, 0, 0, player->eval);
+        *depthReached = empties;
+        return SolveEndgame(b, color, s, bestMove);
+    }
+    if (player->seconds > 0 || player->nodes > 0) {
+        return SearchIterative(b, color, player->depth, player->seconds, player->nodes,
+                               player->eval, s, bestMove, depthReached);
+    }
+    InitSearch(s, 0, 0, player->eval);
+    *depthReached = player->depth;
+    return NegamaxRoot(b, color, player->depth, s, bestMove);
+}
+
+#ifndef NO_STATS
+/*
+	the statistics of a search for color that chose m as a JSON line:
+	nodes per second, the effective branching factor (the depth-th
+	root of the nodes of the last iteration), tasks spawned, how the
+	nodes ended, the table's counters, and nodes by ply from the root
+	(from ply 1) and by iteration (from depth 1).
+*/
+static void WriteMoveStats(FILE *out, int color, Move m, int score, int depth, double seconds,
+                           const Search *s) {
+    const NodeStats *st = &s->stats;
+    ull nodes = SearchNodes(s);
+    ull last = (depth > 0 && depth < MAX_PLY) ? s->iterations[depth] : 0;
+    TTStats tts = SumTTStats(ttstats);
+    fprintf(out, "{\"color\": \"%c\", \"row\": %d, \"col\": %d, \"score\": %d, \"depth\": %d, "
+            "\"nodes\": %llu, \"seconds\": %.6f, \"nps\": %.0f, \"ebf\": %.3f, \"tasks\": %llu, "
+            "\"leaves\": %llu, \"terminals\": %llu, \"passes\": %llu, \"cutoffs\": %llu, "
+            "\"first_cutoffs\": %llu, \"tt_cutoffs\": %llu, \"tt_probes\": %llu, \"tt_hits\": %llu, "
+            "\"tt_collisions\": %llu, \"tt_stores\": %llu, \"tt_replacements\": %llu, "
+            "\"reused\": %llu, \"reused_cutoffs\": %llu, \"reused_fraction\": %.4f, ",
+            color == X_BLACK ? 'X' : 'O', m.row, m.col, score, depth,
+            nodes, seconds, seconds > 0 ? nodes / seconds : 0.0,
+            (last > 0) ? pow((double)last, 1.0 / depth) : 0.0, SearchTasks(s),
+            st->leaves, st->terminals, st->passes, st->cutoffs,
+            st->firstcuts, st->ttcuts, tts.probes, tts.hits,
+            tts.collisions, tts.stores, tts.replacements,
+            st->reused, st->reusedcuts, nodes ? (double)st->reused / nodes : 0.0);
+#ifdef PROFILE
+    fprintf(out, "\"work\": %llu, \"span\": %llu, \"parallelism\": %.2f, \"plies\": [",
+            s->work, s->span, s->span ? (double)s->work / s->span : 0.0);
+#else
+    fprintf(out, "\"plies\": [");
+#endif
+    int plies = MAX_PLY;
+    while (plies > 1 && st->plies[plies - 1] == 0) plies--;
+    for (int ply = 1; ply < plies; ply++) fprintf(out, "%s%llu", ply > 1 ? ", " : "", st->plies[ply]);
+    fprintf(out, "], \"iterations\": [");
+    for (int d = 1; d <= depth && d < MAX_PLY; d++) fprintf(out, "%s%llu", d > 1 ? ", " : "", s->iterations[d]);
+    fprintf(out, "]}\n");
+    fflush(out);
+}
+#endif
+
+/*
+	what the search of a computer move leaves for the next one in the
+	game: the table, and the principal variation it expects, read back
+	from the table. when the game follows that line, the next search
+	puts what is left of it back into the table, for move ordering,
+	where later stores evicted it. each computer move searched starts
+	a new table generation (1..255), so stores evict the entries of
+	earlier moves first and the search can count the nodes that hit
+	them. the history and killers start over every move: carried over
+	(halved, the killers moved up the plies played) they cost more
+	nodes than they saved.
+*/
+typedef struct {
+    Board board;
+    int color;          // to move
+    int move;           // expected, NO_MOVE to pass
+} PVNode;
+
+typedef struct {
+    int pvlength;
+    PVNode pv[MAX_PLY];
+    int ahead;          // plies of the last principal variation ahead of this search
+    int restored;       // of them put back into the table
+} SearchContext;
+
+static SearchContext contexts[2];   // of each color's player
+
+// read the principal variation of the search of b for color back from the table
+static void SavePV(const Board &b, int color, const Player *player, int depth) {
+    SearchContext *c = &contexts[color];
+    ull salt = player->eval ? player->eval->salt : 0;
+    Board board = b;
+    int to = color;
+    c->pvlength = 0;
+    while (tt && c->pvlength < depth && c->pvlength < MAX_PLY) {
+        ull me = board.disks[to], opp = board.disks[OTHERCOLOR(to)];
+        ull moves = LegalMoves(me, opp);
+        PVNode *n = &c->pv[c->pvlength];
+        n->board = board;
+        n->color = to;
+        n->move = NO_MOVE;
+        if (moves == 0) {
+            if (LegalMoves(opp, me) == 0) break;   // game over
+        } else {
+            Position p;
+            ull data;
+            SetPosition(&p, board);
+            if (!ProbeTT(PositionKey(p, to) ^ salt, &data) || TT_MOVE(data) == NO_MOVE ||
+                !(moves & (0x1ULL << TT_MOVE(data)))) {
+                break;
+            }
+            n->move = TT_MOVE(data);
+            ApplyFlips(&board, to, n->move, FlipMask(n->move, me, opp));
+        }
+        c->pvlength++;
+        to = OTHERCOLOR(to);
+    }
+}
+
+// if the game followed color's last principal variation to b, put the rest of it back into the table
+static void RestorePV(const Board &b, int color, const Player *player) {
+    SearchContext *c = &contexts[color];
+    ull salt = player->eval ? player->eval->salt : 0;
+    int i = 0;
+    while (i < c->pvlength && !(c->pv[i].color == color && memcmp(&c->pv[i].board, &b, sizeof(b)) == 0)) i++;
+    c->ahead = c->pvlength - i;
+    c->restored = 0;
+    for (; tt && i < c->pvlength; i++) {
+        const PVNode *n = &c->pv[i];
+        if (n->move == NO_MOVE) continue;
+        Position p;
+        ull data;
+        SetPosition(&p, n->board);
+        ull key = PositionKey(p, n->color) ^ salt;
+        if (!ProbeTT(key, &data)) {
+            // depth 0: never a bound, only the move to try first
+            StoreTT(key, 0, 0, 0, n->move);
+            c->restored++;
+        }
+    }
+}
+
+// set up the search of a computer move for color at b from what the last one left
+static void BeginMoveSearch(const Board &b, int color, const Player *player) {
+    tt_generation = tt_generation % 255 + 1;
+    ClearOrdering();
+    RestorePV(b, color, player);
+}
+
+#ifndef NO_STATS
+// how much of the search of a computer move for color the earlier ones saved, at verbosity 3
+static void PrintReuse(const Search *s, int color) {
+    ull nodes = SearchNodes(s);
+    const SearchContext *c = &contexts[color];
+    printf("Reused: %.1f%% of nodes hit table entries of earlier moves, %.1f%% cut off with them; "
+           "%d plies of the last principal variation ahead, %d put back\n",
+           nodes ? 100.0 * s->stats.reused / nodes : 0.0, nodes ? 100.0 * s->stats.reusedcuts / nodes : 0.0,
+           c->ahead, c->restored);
+}
+#endif
+
+/*
+	pondering (--ponder): after a computer move, while a human thinks
+	over the reply, search the position after the reply the computer
+	expects, as its next move would, in a thread of its own. the
+	expected reply is the best move the table holds for the position
+	after the computer's move (its search just went through it), else
+	the first in move order. if the human plays it, the next
+	ComputerTurn takes that search's result, waiting for the rest of it
+	(with a time budget, for at most the budget from the reply on);
+	if not, it stops the search, and the table keeps what it found.
+	InitSearch clears the root's cutoff, so a stop that lands before
+	the thread gets there would be lost: the stopper raises stopped
+	and keeps cutting the search off until the thread is done.
+	the computer does not ponder against itself: both sides share the
+	workers.
+*/
+typedef struct {
+    pthread_t thread;
+    bool active;        // a ponder search was started and not yet taken or stopped
+    Board board;        // the position searched, after the expected reply
+    int color;          // to move in it
+    const Player *player;
+    double start;       // Now() when it began
+    Search search;
+    Move move;
+    int score;
+    int reached;
+    volatile int done;
+    volatile int stopped;   // the search was stopped, its result is not complete
+} Ponder;
+
+static bool pondering = false;   // --ponder
+static Ponder ponder;
+
+// the reply to b the computer playing player expects from color
+static int ExpectedReply(const Board &b, int color, ull replies, const Player *player) {
+    ull data;
+    if (tt) {
+        Position p;
+        SetPosition(&p, b);
+        ull key = PositionKey(p, color) ^ (player->eval ? player->eval->salt : 0);
+        if (ProbeTT(key, &data) && TT_MOVE(data) != NO_MOVE && (replies & (0x1ULL << TT_MOVE(data)))) {
+            return TT_MOVE(data);
+        }
+    }
+    int moveList[64];
+    OrderMoves(replies, color, NO_MOVE, 0, 0, moveList);
+    return moveList[0];
+}
+
+// whether player's ponder search of b deepens until PonderHit stops it
+static bool PonderDeepens(const Board &b, const Player *player) {
+    int empties = 64 - __builtin_popcountll(b.disks[X_BLACK] | b.disks[O_WHITE]);
+    return player->seconds > 0 && empties > endgame_empties;
+}
+
+// SearchPosition, but with a time budget deepening until PonderHit stops it
+static int PonderPosition(const Board &b, int color, const Player *player, Search *s, Move *bestMove,
+                          int *depthReached) {
+    if (PonderDeepens(b, player)) {
+        return SearchIterative(b, color, player->depth, 0, player->nodes, player->eval, s, bestMove,
+                               depthReached);
+    }
+    return SearchPosition(b, color, player, s, bestMove, depthReached);
+}
+
+static void *PonderThread(void *arg) {
+    Ponder *p = (Ponder *)arg;
+    if (!p->stopped) {
+        ParallelRun([&] { p->score = PonderPosition(p->board, p->color, p->player, &p->search, &p->move, &p->reached); });
+    }
+    p->done = 1;
+    return 0;
+}
+
+// color, playing as player, just moved to b: search the position after the expected reply
+static void StartPondering(const Board &b, int color, const Player *player) {
+    int other = OTHERCOLOR(color);
+    Board next = b;
+    ull replies = LegalMoves(b.disks[other], b.disks[color]);
+    if (replies) {
+        int sq = ExpectedReply(b, other, replies, player);
+        ApplyFlips(&next, other, sq, FlipMask(sq, next.disks[other], next.disks[color]));
+    }
+    if (LegalMoves(next.disks[color], next.disks[other]) == 0) return;
+    Move m;
+    int score, depth;
+    if (BookMove(next, color, player->depth, &m, &score, &depth)) return;
+
+    BeginMoveSearch(next, color, player);
+    ClearTTStats();
+    ClearNodeStats();
+    ponder.board = next;
+    ponder.color = color;
+    ponder.player = player;
+    ponder.start = Now();
+    ponder.done = 0;
+    ponder.stopped = 0;
+    ponder.reached = 0;
+    ponder.active = true;
+    pthread_create(&ponder.thread, 0, PonderThread, &ponder);
+}
+
+// stop the ponder search and wait for its thread
+static void CancelPonder(void) {
+    struct timespec ts = { 0, 1000000 };
+    ponder.stopped = 1;
+    while (!ponder.done) {
+        ponder.search.root.cutoff = 1;
+        nanosleep(&ts, 0);
+    }
+    pthread_join(ponder.thread, 0);
+}
+
+/*
+	true if the ponder search searched b for color as player and its
+	result is in ponder; else stop it. either way it is over. without a
+	time budget the search is waited for to the end: cut off, its
+	result would be no search's. with one, a search deepening past the
+	budget is stopped and gives the deepest depth it completed.
+*/
+static bool PonderHit(const Board &b, int color, const Player *player) {
+    if (!ponder.active) return false;
+    ponder.active = false;
+    bool hit = ponder.color == color && ponder.player == player &&
+               memcmp(&ponder.board, &b, sizeof(b)) == 0;
+    bool deepens = hit && PonderDeepens(b, player);
+    if (deepens) {
+        double deadline = Now() + player->seconds;
+        struct timespec ts = { 0, 1000000 };
+        while (!ponder.done && Now() < deadline) nanosleep(&ts, 0);
+    }
+    if (!hit || (deepens && !ponder.done)) {
+        CancelPonder();
+    } else {
+        pthread_join(ponder.thread, 0);
+    }
+    // stopped before depth 1 completed: nothing to play
+    return hit && ponder.reached > 0;
+}
+
+static void StopPondering(void) {
+    if (!ponder.active) return;
+    ponder.active = false;
+    CancelPonder();
+}
+
+// Computer Turn
+// Return 1 if move was made, 0 if none possible; *seconds is set to
+// the time spent searching. The opening book's move, if it has one
+// from a search at least as deep as the player's, is played unsearched,
+// and a ponder search of the position is waited for rather than redone.
+int ComputerTurn(Board *b, int color, const Player *player, double *seconds) {
+    // Check if there's a legal move
+    Board legal;
+    int num_moves = EnumerateLegalMoves(*b, color, &legal);
+    if (num_moves == 0) {
+        return 0;
+    }
+
+    Move bestM;
+    int bestScore;
+    int reached;
+    Search search;
+    Search *s = &search;
+    int empties = 64 - __builtin_popcountll(b->disks[X_BLACK] | b->disks[O_WHITE]);
+    bool solving = empties <= endgame_empties;
+    double start = Now();
+    bool booked = false;
+    bool pondered = PonderHit(*b, color, player);
+    if (pondered) {
+        s = &ponder.search;
+        bestM = ponder.move;
+        bestScore = ponder.score;
+        reached = ponder.reached;
+    } else {
+        BeginMoveSearch(*b, color, player);
+        ClearTTStats();
+        ClearNodeStats();
+        booked = BookMove(*b, color, player->depth, &bestM, &bestScore, &reached);
+        trace_start = start;
+        tracing = trace_prefix && !booked;
+        if (!booked) ParallelRun([&] { bestScore = SearchPosition(*b, color, player, s, &bestM, &reached); });
+        tracing = false;
+    }
+    double elapsed = Now() - start;
+    *seconds = elapsed;
+    if (trace_prefix && !booked && !pondered) WriteTrace(++trace_moves);
+    if (!booked) SavePV(*b, color, player, reached);
+#ifndef NO_STATS
+    // a pondered search took the time since it began
+    if (statsout && !booked) {
+        WriteMoveStats(statsout, color, bestM, bestScore, reached, pondered ? Now() - ponder.start : elapsed, s);
+    }
+#endif
+
+    Board before = *b;
+    int sq = BOARD_BIT_INDEX(bestM.row, bestM.col);
+    ull flipped = FlipMask(sq, b->disks[color], b->disks[OTHERCOLOR(color)]);
+    ApplyFlips(b, color, sq, flipped);
+    if (verbosity == 0) return 1;
+
+    ull nodes = booked ? 0 : SearchNodes(s);
+    printf("\n[%c] Computer chooses move (%d, %d) => Score: %d\n",
+           (color==X_BLACK ? 'X':'O'), bestM.row, bestM.col, bestScore);
+    if (pondered) printf("Ponder hit: searched for %.3f s before the reply\n", start - ponder.start);
+    if (booked) {
+        printf("Book move, searched to depth %d\n", reached);
+    } else if (solving) {
+        if (endgame_wld) {
+            printf("Endgame: %d empties solved, %s", empties,
+                   bestScore > 0 ? "win" : bestScore < 0 ? "loss" : "draw");
+        } else {
+            printf("Endgame: %d empties solved, exact score %d", empties, bestScore);
+        }
+        printf(": %llu positions in %.3f s (%.0f positions/s)\n",
+               nodes, elapsed, elapsed > 0 ? nodes / elapsed : 0.0);
+    } else if (player->seconds > 0 || player->nodes > 0 || verbosity == 1) {
+        printf("Searched to depth %d: %llu nodes in %.3f s\n", reached, nodes, elapsed);
+    }
+    if (verbosity == 1) return 1;
+
+    // the flips in the order FlipDisks finds them, as a human move prints them
+    int flips = FlipDisks(bestM, &before, color, 1, 0);
+
+    printf("%c flipped %d disks.\n", (color==X_BLACK ? 'X':'O'), flips);
+    if (verbosity >= 3) {
+        PrintTTStats();
+        PrintOrderStats();
+#ifndef NO_STATS
+        if (!booked) PrintReuse(s, color);
+#endif
+        if (!booked) PrintSpawnStats(s);
+#ifdef PROFILE
+        if (!booked) PrintProfile(s);
+#endif
+    }
+    PrintBoard(*b);
+    return 1; 
+}
+
+/*
+	play a game from b with color to move until neither side can move,
+	logging the time of every computer move.
+*/
+static void PlayGame(Board *b, int color, const Player players[2], GameLog *log) {
+    int movePossible[2] = { 1, 1 };
+    log->nmoves = 0;
+    while (movePossible[X_BLACK] || movePossible[O_WHITE]) {
+        if (players[color].type == 'h') {
+            movePossible[color] = HumanTurn(b, color);
+        } else {
+            double seconds;
+            movePossible[color] = ComputerTurn(b, color, &players[color], &seconds);
+            if (movePossible[color] && log->nmoves < MAX_GAME_MOVES) {
+                log->color[log->nmoves] = color;
+                log->seconds[log->nmoves++] = seconds;
+            }
+            if (pondering && players[OTHERCOLOR(color)].type == 'h') StartPondering(*b, color, &players[color]);
+        }
+        color = OTHERCOLOR(color);
+    }
+    StopPondering();
+}
+
+// the result, the search time and the time of every computer move, on one line
+static void PrintSummary(const Board &b, const GameLog *log) {
+    int x = __builtin_popcountll(b.disks[X_BLACK]);
+    int o = __builtin_popcountll(b.disks[O_WHITE]);
+    double total[2] = { 0, 0 };
+    for (int i = 0; i < log->nmoves; i++) total[log->color[i]] += log->seconds[i];
+    printf("X %d O %d %s: %d computer moves, search %.3f s (X %.3f s, O %.3f s); ms per move:",
+           x, o, x > o ? "X wins" : x < o ? "O wins" : "tie", log->nmoves,
+           total[X_BLACK] + total[O_WHITE], total[X_BLACK], total[O_WHITE]);
+    for (int i = 0; i < log->nmoves; i++) printf(" %.3f", 1000 * log->seconds[i]);
+    printf("\n");
+}
+
+/*
+	evaluations per second of the disk count and of the pattern
+	evaluation with each extraction kernel and with the indices kept
+	by MakeMove with weights e, over npositions positions from random
+	games.
+*/
+static void BenchEval(long npositions, const EvalWeights *e) {
+    Position *positions = (Position *)malloc(npositions * sizeof(Position));
+    int *colors = (int *)malloc(npositions * sizeof(int));
+    ull seed = 0x9E3779B97F4A7C15ULL;
+    long n = 0;
+    while (n < npositions) {
+        Position p;
+        SetPosition(&p, start);
+        int color = X_BLACK, passes = 0;
+        while (passes < 2 && n < npositions) {
+            ull moves = LegalMoves(p.board.disks[color], p.board.disks[OTHERCOLOR(color)]);
+            positions[n] = p;
+            colors[n++] = color;
+            if (moves == 0) {
+                passes++;
+            } else {
+                int k = NextRandom(&seed) % __builtin_popcountll(moves);
+                while (k--) moves &= moves - 1;
+                Position child;
+                MakeMove(&p, color, __builtin_ctzll(moves), &child);
+                p = child;
+                passes = 0;
+            }
+            color = OTHERCOLOR(color);
+        }
+    }
+
+    long sum = 0;
+    double start_time = Now();
+    for (long i = 0; i < n; i++) sum += DiskDifference(positions[i].board, colors[i]);
+    double elapsed = Now() - start_time;
+    printf("%-20s %12.0f evals/s  (checksum %ld)\n", "disk count", n / elapsed, sum);
+
+    struct { const char *name; void (*kernel)(ull, ull, unsigned short *); int supported; } extract[] = {
+        { "pattern/scalar", PatternIndicesScalar, 1 },
+#if defined(__x86_64__) || defined(__i386__)
+        { "pattern/pext", PatternIndicesBMI2, __builtin_cpu_supports("bmi2") },
+#endif
+    };
+    void (*selected)(ull, ull, unsigned short *) = pattern_indices_kernel;
+    for (size_t k = 0; k < sizeof(extract)/sizeof(extract[0]); k++) {
+        if (!extract[k].supported) {
+            printf("%-20s not supported on this cpu\n", extract[k].name);
+            continue;
+        }
+        pattern_indices_kernel = extract[k].kernel;
+        sum = 0;
+        start_time = Now();
+        for (long i = 0; i < n; i++) sum += PatternEval(e, positions[i].board, colors[i]);
+        elapsed = Now() - start_time;
+        printf("%-20s %12.0f evals/s  (checksum %ld)\n", extract[k].name, n / elapsed, sum);
+    }
+    pattern_indices_kernel = selected;
+
+    sum = 0;
+    start_time = Now();
+    for (long i = 0; i < n; i++) sum += EvaluatePosition(positions[i], colors[i], e);
+    elapsed = Now() - start_time;
+    printf("%-20s %12.0f evals/s  (checksum %ld)\n", "pattern/incremental", n / elapsed, sum);
+    free(positions);
+    free(colors);
+}
+
+/*
+	batch analysis: read positions from a file, one per line, search
+	each like a computer player would and write one result line per
+	position. a position is either two 64-bit bitboards in hex, X's
+	then O's, or a 64 character board read row by row from (1,1) with
+	X, O and - (or .) for empty; either is followed by the side to move,
+	X or O. blank lines and lines starting with # are skipped.
+
+	positions are read BATCH_CHUNK at a time and searched in parallel,
+	each search also spawning its own work, so the workers stay busy
+	even when one position takes much longer than the others. results
+	are written in input order.
+*/
+#define BATCH_CHUNK 256
+
+typedef struct {
+    long line;          // line number in the input
+    Board board;
+    int color;
+    Move move;          // (0, 0) if color has to pass
+    int score;
+    int depth;
+    ull nodes;
+    double seconds;
+} BatchItem;
+
+// parse a position; returns 0 if line does not hold one
+static int ParsePosition(const char *line, Board *b, int *color) {
+    char board[65], side;
+    ull x, o;
+    if (sscanf(line, "%64s %c", board, &side) == 2 && strlen(board) == 64 &&
+        strspn(board, "XO-.") == 64) {
+        b->disks[X_BLACK] = b->disks[O_WHITE] = 0ULL;
+        for (int i = 0; i < 64; i++) {
+            if (board[i] == 'X') b->disks[X_BLACK] |= 0x1ULL << (63 - i);
+            if (board[i] == 'O') b->disks[O_WHITE] |= 0x1ULL << (63 - i);
+        }
+    } else if (sscanf(line, "%llx %llx %c", &x, &o, &side) == 3 && (x & o) == 0) {
+        b->disks[X_BLACK] = x;
+        b->disks[O_WHITE] = o;
+    } else {
+        return 0;
+    }
+    if (side != 'X' && side != 'O') return 0;
+    *color = (side == 'X') ? X_BLACK : O_WHITE;
+    return 1;
+}
+
+static void AnalyzeItem(BatchItem *item, const Player *analyst) {
+    Search search;
+    double start = Now();
+    item->score = SearchPosition(item->board, item->color, analyst, &search, &item->move, &item->depth);
+    item->nodes = SearchNodes(&search);
+    item->seconds = Now() - start;
+}
+
+static void PrintItem(FILE *out, const BatchItem *item, int json) {
+    if (json) {
+        fprintf(out, "{\"line\": %ld, \"row\": %d, \"col\": %d, \"score\": %d, "
+                "\"depth\": %d, \"nodes\": %llu, \"seconds\": %.6f}\n",
+                item->line, item->move.row, item->move.col, item->score,
+                item->depth, item->nodes, item->seconds);
+    } else {
+        fprintf(out, "%ld,%d,%d,%d,%d,%llu,%.6f\n",
+                item->line, item->move.row, item->move.col, item->score,
+                item->depth, item->nodes, item->seconds);
+    }
+}
+
+/*
+	analyze the positions in path ("-" for stdin) as analyst would
+	and write the results to out as CSV, or as JSON lines if json is
+	set. returns the number of lines that held no position.
+*/
+static long RunBatch(const char *path, const Player *analyst, int json, FILE *out) {
+    FILE *in = strcmp(path, "-") ? fopen(path, "r") : stdin;
+    if (!in) {
+        perror(path);
+        return -1;
+    }
+    BatchItem *items = (BatchItem *)malloc(BATCH_CHUNK * sizeof(BatchItem));
+    char line[256];
+    long lineno = 0, errors = 0;
+
+    ClearTTStats();
+    ClearOrdering();
+    if (!json) fprintf(out, "line,row,col,score,depth,nodes,seconds\n");
+    for (;;) {
+        int n = 0;
+        while (n < BATCH_CHUNK && fgets(line, sizeof(line), in)) {
+            lineno++;
+            const char *text = line + strspn(line, " \t");
+            if (*text == '#' || *text == '\n' || *text == '\0') continue;
+            if (!ParsePosition(text, &items[n].board, &items[n].color)) {
+                fprintf(stderr, "%s:%ld: not a position\n", path, lineno);
+                errors++;
+                continue;
+            }
+            items[n++].line = lineno;
+        }
+        if (n == 0) break;
+
+        ParallelFor(n, [&](long i) {
+            AnalyzeItem(&items[i], analyst);
+        });
+        for (int i = 0; i < n; i++) PrintItem(out, &items[i], json);
+        fflush(out);
+    }
+
+    free(items);
+    if (in != stdin) fclose(in);
+    return errors;
+}
+
+/*
+	perft: the number of leaves of the game tree depth plies below b,
+	to measure and check move generation apart from search. a pass is
+	a ply, and a finished game is a leaf however early it ends. the
+	last ply is counted rather than played.
+*/
+#define PERFT_SERIAL_DEPTH 5
+
+ull Perft(const Board &b, int color, int depth) {
+    ull me = b.disks[color], opp = b.disks[OTHERCOLOR(color)];
+    if (depth == 0) return 1;
+    ull moves = LegalMoves(me, opp);
+    if (moves == 0) {
+        if (LegalMoves(opp, me) == 0) return 1;   // game over
+        return Perft(b, OTHERCOLOR(color), depth - 1);
+    }
+    if (depth == 1) return __builtin_popcountll(moves);
+
+    ull leaves = 0;
+    for (; moves; moves &= moves - 1) {
+        int sq = __builtin_ctzll(moves);
+        Board child = b;
+        ApplyFlips(&child, color, sq, FlipMask(sq, me, opp));
+        leaves += Perft(child, OTHERCOLOR(color), depth - 1);
+    }
+    return leaves;
+}
+
+// Perft with the moves of each node more than PERFT_SERIAL_DEPTH plies up in a ParallelFor
+ull PerftParallel(const Board &b, int color, int depth) {
+    if (depth <= PERFT_SERIAL_DEPTH) return Perft(b, color, depth);
+    ull me = b.disks[color], opp = b.disks[OTHERCOLOR(color)];
+    ull moves = LegalMoves(me, opp);
+    if (moves == 0) {
+        if (LegalMoves(opp, me) == 0) return 1;   // game over
+        return PerftParallel(b, OTHERCOLOR(color), depth - 1);
+    }
+
+    int moveList[64];
+    ull leaves[64];
+    int n = 0;
+    for (; moves; moves &= moves - 1) moveList[n++] = __builtin_ctzll(moves);
+    ParallelFor(n, [&](long i) {
+        Board child = b;
+        ApplyFlips(&child, color, moveList[i], FlipMask(moveList[i], me, opp));
+        leaves[i] = PerftParallel(child, OTHERCOLOR(color), depth - 1);
+    });
+    ull total = 0;
+    for (int i = 0; i < n; i++) total += leaves[i];
+    return total;
+}
+
+// perft to depths 1..maxdepth from b, serial and parallel
+static int RunPerft(const Board &b, int color, int maxdepth) {
+    printf("perft, %c to move\n", color == X_BLACK ? 'X' : 'O');
+    printf("%5s %15s %10s %14s %10s %14s\n",
+           "depth", "leaves", "serial s", "leaves/s", "parallel s", "leaves/s");
+    int errors = 0;
+    for (int depth = 1; depth <= maxdepth; depth++) {
+        double start_time = Now();
+        ull serial = Perft(b, color, depth);
+        double serial_time = Now() - start_time;
+        start_time = Now();
+        ull parallel = PerftParallel(b, color, depth);
+        double parallel_time = Now() - start_time;
+        printf("%5d %15llu %10.3f %14.0f %10.3f %14.0f%s\n", depth, serial,
+               serial_time, serial_time > 0 ? serial / serial_time : 0.0,
+               parallel_time, parallel_time > 0 ? parallel / parallel_time : 0.0,
+               serial == parallel ? "" : "  parallel count differs");
+        errors += (serial != parallel);
+    }
+    return errors;
+}
+
+/*
+	self-play tournament: engine A, with the X player's options, plays
+	engine B, with the O player's, from a set of openings, each opening
+	twice with the colors swapped. all the games run at once in a
+	ParallelFor and every search in them spawns its own work, so the
+	workers go where the work is: across games while many are left,
+	into the searches of the last few at the end. the transposition
+	table and move ordering are shared by the games as in --batch;
+	engines with different weights keep apart in the table by their
+	salt.
+
+	time budgets are wall clock, and with games running at once each
+	search gets only a share of the machine, so depths or node budgets
+	give fairer comparisons.
+
+	openings come from a file in the --batch format, or are all the
+	positions some plies from the start, counting positions that are
+	symmetric to each other once.
+*/
+#define MAX_OPENING_PLIES 8
+#define ENGINE_A 0
+#define ENGINE_B 1
+
+typedef struct {
+    Board board;
+    int color;          // to move
+} Opening;
+
+typedef struct {
+    long opening;
+    int a;              // A's color
+    Board board;        // at the end of the game
+    int moves[2];       // moves of A, B
+    double seconds[2];  // search time of A, B
+    ull nodes[2];
+} TournamentGame;
+
+static int CompareOpenings(const void *x, const void *y) {
+    const Opening *p = (const Opening *)x, *q = (const Opening *)y;
+    for (int c = X_BLACK; c <= O_WHITE; c++) {
+        if (p->board.disks[c] != q->board.disks[c]) return p->board.disks[c] < q->board.disks[c] ? -1 : 1;
+    }
+    return p->color - q->color;
+}
+
+/*
+	the distinct positions one ply after the n positions in level, on
+	their canonical boards, sorted, in *next; returns how many. games
+	that end are dropped.
+*/
+static long ExpandOpenings(const Opening *level, long n, Opening **next) {
+    long size = 1;
+    for (long i = 0; i < n; i++) {
+        const Board &b = level[i].board;
+        size += __builtin_popcountll(LegalMoves(b.disks[level[i].color], b.disks[OTHERCOLOR(level[i].color)])) + 1;
+    }
+    Opening *o = (Opening *)malloc(size * sizeof(Opening));
+    long m = 0;
+    for (long i = 0; i < n; i++) {
+        const Board &b = level[i].board;
+        int color = level[i].color;
+        ull me = b.disks[color], opp = b.disks[OTHERCOLOR(color)];
+        ull moves = LegalMoves(me, opp);
+        if (moves == 0 && LegalMoves(opp, me) != 0) {
+            o[m].board = b;
+            o[m++].color = OTHERCOLOR(color);
+        }
+        for (; moves; moves &= moves - 1) {
+            int sq = __builtin_ctzll(moves);
+            Board child = b;
+            ApplyFlips(&child, color, sq, FlipMask(sq, me, opp));
+            o[m].board = CanonicalBoard(child, 0);
+            o[m++].color = OTHERCOLOR(color);
+        }
+    }
+    qsort(o, m, sizeof(Opening), CompareOpenings);
+    long distinct = 0;
+    for (long i = 0; i < m; i++) {
+        if (distinct == 0 || CompareOpenings(&o[i], &o[distinct - 1]) != 0) o[distinct++] = o[i];
+    }
+    *next = o;
+    return distinct;
+}
+
+// the distinct positions plies from the start, in *openings; returns how many
+static long MakeOpenings(int plies, Opening **openings) {
+    Opening *level = (Opening *)malloc(sizeof(Opening));
+    level[0].board = CanonicalBoard(start, 0);
+    level[0].color = X_BLACK;
+    long n = 1;
+    for (int p = 0; p < plies; p++) {
+        Opening *next;
+        n = ExpandOpenings(level, n, &next);
+        free(level);
+        level = next;
+    }
+    *openings = level;
+    return n;
+}
+
+// the positions in path, in *openings; returns how many, or -1 on errors
+static long ReadOpenings(const char *path, Opening **openings) {
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return -1;
+    }
+    long n = 0, size = 64, lineno = 0, errors = 0;
+    Opening *o = (Opening *)malloc(size * sizeof(Opening));
+    char line[256];
+    while (fgets(line, sizeof(line), in)) {
+        lineno++;
+        const char *text = line + strspn(line, " \t");
+        if (*text == '#' || *text == '\n' || *text == '\0') continue;
+        if (n == size) o = (Opening *)realloc(o, (size *= 2) * sizeof(Opening));
+        if (!ParsePosition(text, &o[n].board, &o[n].color)) {
+            fprintf(stderr, "%s:%ld: not a position\n", path, lineno);
+            errors++;
+            continue;
+        }
+        n++;
+    }
+    fclose(in);
+    if (n == 0 && errors == 0) fprintf(stderr, "%s: no positions\n", path);
+    *openings = o;
+    return (errors || n == 0) ? -1 : n;
+}
+
+// play one game of the tournament, with no output
+static void PlayTournamentGame(TournamentGame *g, const Opening *opening, const Player engines[2]) {
+    Board b = opening->board;
+    int color = opening->color, passes = 0;
+    while (passes < 2) {
+        ull me = b.disks[color], opp = b.disks[OTHERCOLOR(color)];
+        if (LegalMoves(me, opp) == 0) {
+            passes++;
+        } else {
+            int e = (color == g->a) ? ENGINE_A : ENGINE_B;
+            Search search;
+            Move m;
+            int reached;
+            double start_time = Now();
+            SearchPosition(b, color, &engines[e], &search, &m, &reached);
+            g->seconds[e] += Now() - start_time;
+            g->nodes[e] += SearchNodes(&search);
+            g->moves[e]++;
+            int sq = BOARD_BIT_INDEX(m.row, m.col);
+            ApplyFlips(&b, color, sq, FlipMask(sq, me, opp));
+            passes = 0;
+        }
+        color = OTHERCOLOR(color);
+    }
+    g->board = b;
+}
+
+static void PrintEngine(const char *label, const Player *p) {
+    printf("%s: depth %d", label, p->depth);
+    if (p->seconds > 0) printf(", %.3f s per move", p->seconds);
+    if (p->nodes > 0) printf(", %llu nodes per move", p->nodes);
+    printf(", eval %s\n", p->eval ? p->eval->name : "disks");
+}
+
+/*
+	play ngames games of engines[ENGINE_A] against engines[ENGINE_B],
+	game i from opening i / 2 (cycling through the openings) with A
+	playing X in even games and O in odd ones. prints a line per game
+	unless quiet, then the totals from A's side: wins, losses and
+	draws, the score with its standard error and the Elo difference it
+	implies, the average disc differential, search time and throughput.
+*/
+static void RunTournament(const Opening *openings, long nopenings, long ngames, const Player engines[2]) {
+    TournamentGame *games = (TournamentGame *)calloc(ngames, sizeof(TournamentGame));
+    for (long i = 0; i < ngames; i++) {
+        games[i].opening = (i / 2) % nopenings;
+        games[i].a = (i % 2) ? O_WHITE : X_BLACK;
+    }
+
+    ClearTTStats();
+    ClearOrdering();
+    double start_time = Now();
+    ParallelFor(ngames, [&](long i) {
+        PlayTournamentGame(&games[i], &openings[games[i].opening], engines);
+    });
+    double elapsed = Now() - start_time;
+
+    int wins = 0, losses = 0, draws = 0;
+    double points = 0, squares = 0, differential = 0, seconds[2] = { 0, 0 };
+    ull nodes[2] = { 0, 0 };
+    long moves[2] = { 0, 0 };
+    for (long i = 0; i < ngames; i++) {
+        const TournamentGame *g = &games[i];
+        int a = __builtin_popcountll(g->board.disks[g->a]);
+        int b = __builtin_popcountll(g->board.disks[OTHERCOLOR(g->a)]);
+        double p = (a > b) ? 1 : (a == b) ? 0.5 : 0;
+        wins += (a > b);
+        losses += (a < b);
+        draws += (a == b);
+        points += p;
+        squares += p * p;
+        differential += a - b;
+        for (int e = ENGINE_A; e <= ENGINE_B; e++) {
+            seconds[e] += g->seconds[e];
+            nodes[e] += g->nodes[e];
+            moves[e] += g->moves[e];
+        }
+        if (verbosity > 0) {
+            printf("game %ld: opening %ld, A plays %c: X %d O %d, A %+d\n", i + 1, g->opening + 1,
+                   g->a == X_BLACK ? 'X' : 'O',
+                   __builtin_popcountll(g->board.disks[X_BLACK]),
+                   __builtin_popcountll(g->board.disks[O_WHITE]), a - b);
+        }
+    }
+
+    long used = ((ngames + 1) / 2 < nopenings) ? (ngames + 1) / 2 : nopenings;
+    double score = points / ngames;
+    double error = sqrt((squares / ngames - score * score) / ngames);
+    PrintEngine("A", &engines[ENGINE_A]);
+    PrintEngine("B", &engines[ENGINE_B]);
+    printf("%ld games from %ld openings: A %d wins, %d losses, %d draws; score %.1f%% +/- %.1f%%",
+           ngames, used, wins, losses, draws, 100 * score, 100 * error);
+    if (score > 0 && score < 1) printf(" (Elo %+.0f)", 0.0 - 400 * log10(1 / score - 1));
+    printf("\ndisc differential %+.2f per game\n", differential / ngames);
+    for (int e = ENGINE_A; e <= ENGINE_B; e++) {
+        printf("%c searched %.3f s, %llu nodes, %.3f ms per move\n", e == ENGINE_A ? 'A' : 'B',
+               seconds[e], nodes[e], moves[e] ? 1000 * seconds[e] / moves[e] : 0.0);
+    }
+    printf("%.3f s, %.1f games per hour\n", elapsed, elapsed > 0 ? ngames * 3600 / elapsed : 0.0);
+    free(games);
+}
+
+/*
+	build or extend the opening book in path: search every position up
+	to plies from the start (one of each set of symmetric positions)
+	that the book lacks, or has only from a search shallower than
+	analyst's depth, the way analyst would. positions are searched
+	BOOK_CHUNK at a time in parallel, each search spawning its own work
+	as in --batch, and the book is rewritten every BOOK_CHECKPOINT
+	seconds, so a build that is stopped picks up about where it left
+	off when run again.
+*/
+#define BOOK_CHUNK 64
+#define BOOK_CHECKPOINT 30.0
+
+// by key, the deepest search first
+static int CompareBookEntries(const void *x, const void *y) {
+    const BookEntry *p = (const BookEntry *)x, *q = (const BookEntry *)y;
+    if (p->key != q->key) return p->key < q->key ? -1 : 1;
+    return q->depth - p->depth;
+}
+
+// write n entries with distinct keys, in order, as the book in path
+static int WriteBook(const char *path, const BookEntry *entries, ull n) {
+    // written aside and renamed over path, so path always holds a whole book
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        perror(tmp);
+        return 0;
+    }
+    int ok = fwrite(book_magic, 1, 8, f) == 8 &&
+             fwrite(&n, sizeof(n), 1, f) == 1 &&
+             fwrite(entries, sizeof(BookEntry), n, f) == n;
+    if (fclose(f) != 0) ok = 0;
+    if (ok && rename(tmp, path) != 0) ok = 0;
+    if (!ok) perror(path);
+    return ok;
+}
+
+static int BuildBook(const char *path, int plies, const Player *analyst) {
+    if (access(path, F_OK) == 0 && !OpenBook(path)) return 0;
+
+    // the positions to search
+    long ntodo = 0, size = 1024;
+    Opening *todo = (Opening *)malloc(size * sizeof(Opening));
+    Opening *level = (Opening *)malloc(sizeof(Opening));
+    level[0].board = CanonicalBoard(start, 0);
+    level[0].color = X_BLACK;
+    long n = 1;
+    for (int p = 0; ; p++) {
+        for (long i = 0; i < n; i++) {
+            const Board &b = level[i].board;
+            int color = level[i].color;
+            if (LegalMoves(b.disks[color], b.disks[OTHERCOLOR(color)]) == 0) continue;
+            const BookEntry *e = ProbeBook(BookKey(b, color));
+            if (e && e->depth >= analyst->depth) continue;
+            if (ntodo == size) todo = (Opening *)realloc(todo, (size *= 2) * sizeof(Opening));
+            todo[ntodo++] = level[i];
+        }
+        if (p == plies) break;
+        Opening *next;
+        n = ExpandOpenings(level, n, &next);
+        free(level);
+        level = next;
+    }
+    free(level);
+
+    // the book so far, then the new entries
+    ull nentries = book_count;
+    BookEntry *entries = (BookEntry *)malloc((book_count + ntodo + 1) * sizeof(BookEntry));
+    if (book) memcpy(entries, book, book_count * sizeof(BookEntry));
+    CloseBook();
+    printf("%s: %llu entries, %ld positions to search to depth %d\n",
+           path, nentries, ntodo, analyst->depth);
+
+    ClearTTStats();
+    ClearOrdering();
+    double start_time = Now(), written = start_time;
+    int ok = (ntodo > 0) || WriteBook(path, entries, nentries);
+    for (long done = 0; ok && done < ntodo; done += BOOK_CHUNK) {
+        long m = (ntodo - done < BOOK_CHUNK) ? ntodo - done : BOOK_CHUNK;
+        BookEntry *found = entries + nentries;
+        ParallelFor(m, [&](long i) {
+            const Opening *o = &todo[done + i];
+            Search search;
+            Move move;
+            int depth;
+            int score = SearchPosition(o->board, o->color, analyst, &search, &move, &depth);
+            found[i].key = BookKey(o->board, o->color);
+            found[i].score = score;
+            found[i].move = BOARD_BIT_INDEX(move.row, move.col);
+            found[i].depth = depth;
+            found[i].unused = 0;
+        });
+        nentries += m;
+        if (done + m < ntodo && Now() - written < BOOK_CHECKPOINT) continue;
+
+        // a position searched again replaces its shallower entry
+        qsort(entries, nentries, sizeof(BookEntry), CompareBookEntries);
+        ull distinct = 0;
+        for (ull i = 0; i < nentries; i++) {
+            if (distinct == 0 || entries[i].key != entries[distinct - 1].key) entries[distinct++] = entries[i];
+        }
+        nentries = distinct;
+        ok = WriteBook(path, entries, nentries);
+        written = Now();
+        printf("%ld/%ld positions searched, %llu entries, %.3f s\n",
+               done + m, ntodo, nentries, Now() - start_time);
+        fflush(stdout);
+    }
+    free(entries);
+    free(todo);
+    return ok;
+}
+
+
+static void Usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [options] [< input]\n"
+            "  --help              print this and exit\n"
+            "  --x=h|c, --o=h|c    X (O) is a human or a computer; asked on stdin if not given\n"
+            "  --depth=N           search depth of the computer players, of --batch and of\n"
+            "                      --games (asked on stdin for players if not given;\n"
+            "                      --batch and --games: 8)\n"
+            "  --x-depth=N, --o-depth=N   likewise for one player\n"
+            "  --workers=N         number of workers of the parallel runtime\n"
+            "  --ponder            search the expected reply while a human thinks\n"
+            "  --quiet             print only a summary line with per-move times at the end\n"
+            "  --verbosity=N       0 as --quiet, 1 a line per move, 2 (default) also the\n"
+            "                      flips and board after every move, 3 also the search\n"
+            "                      statistics\n"
+            "  --stats=FILE        write the search statistics of every searched computer\n"
+            "                      move to FILE (- for stdout) as a JSON line\n"
+            "  --trace=PREFIX      write a timeline of the workers in the search of every\n"
+            "                      computer move to PREFIX-N.json, Chrome trace format\n"
+            "  --mpi-depth=N       under mpirun (othello-mpi), split the moves of root\n"
+            "                      searches N or more plies deep across the ranks (default 6)\n"
+            "  --simd=NAME         move generation kernels: auto (default), avx512, avx2, scalar\n"
+            "  --check-simd[=N]    cross-check every supported kernel against scalar\n"
+            "                      over N random games (default 1000) and exit\n"
+            "  --hash=MB           transposition table size in megabytes\n"
+            "                      (default 64, rounded down to a power of two; 0 disables it)\n"
+            "  --cache=FILE        keep deep search results in FILE for later runs too;\n"
+            "                      the first process to open FILE writes it, others\n"
+            "                      running meanwhile only read it\n"
+            "  --cache-mb=MB       size of a new --cache file in megabytes (default 256)\n"
+            "  --time=SECONDS      per-move time budget: deepen iteratively from depth 1 up\n"
+            "                      to the depth of each computer player\n"
+            "  --nodes=N           per-move node budget, likewise\n"
+            "  --x-time=SECONDS, --o-time=SECONDS, --x-nodes=N, --o-nodes=N\n"
+            "                      likewise for one player\n"
+            "  --spawn-depth=N     never spawn within N plies of the horizon (default 2)\n"
+            "  --spawn-work=N      spawn a node's younger brothers when they hold about\n"
+            "                      2^N nodes or more (default 9)\n"
+            "  --spawn-idle=N      or 2^(N less) when workers may be idle (default 3)\n"
+            "  --order-depth=N     order moves by a shallow search at nodes N or more\n"
+            "                      plies from the horizon (default 0: off)\n"
+            "  --endgame=N         solve the game exactly once N or fewer squares are\n"
+            "                      empty (default 0: off)\n"
+            "  --wld               endgame solves only find win/loss/draw\n"
+            "  --eval=FILE         evaluate with the pattern weights in FILE instead of\n"
+            "                      counting disks; seed for the hand-made weights, disks\n"
+            "                      to count disks\n"
+            "  --x-eval=FILE, --o-eval=FILE   likewise for one player\n"
+            "  --write-eval=FILE   write hand-made starting pattern weights to FILE and exit\n"
+            "  --bench-eval[=N]    time the evaluators on N random positions\n"
+            "                      (default 1000000) and exit\n"
+            "  --batch=FILE        analyze the positions in FILE (- for stdin) and exit;\n"
+            "                      see RunBatch for the format\n"
+            "  --format=csv|json   --batch output: CSV (default) or JSON lines\n"
+            "  --games=N           play N games at once of engine A, with the X player's\n"
+            "                      options, against engine B, with the O player's, and\n"
+            "                      exit; each opening is played twice, colors swapped\n"
+            "  --openings=FILE     the --games openings, in the --batch format\n"
+            "  --opening-plies=N   otherwise the distinct positions N plies from the start\n"
+            "                      (default 4, at most 8)\n"
+            "  --book=FILE         play from the opening book in FILE while it has the\n"
+            "                      position from a search at least as deep as the player's\n"
+            "  --build-book=FILE   search the positions up to --book-plies from the start\n"
+            "                      to --depth (default 12) and add them to the book in\n"
+            "                      FILE, skipping those it has already, and exit\n"
+            "  --book-plies=N      plies from the start for --build-book (default 6)\n"
+            "  --perft=N           count the leaves of the game tree to depths 1..N,\n"
+            "                      serially and in parallel, and exit\n"
+            "  --position=POS      the position for --perft, in the --batch format\n"
+            "                      (default: the start position, X to move)\n",
+            prog);
+}
+
+
+// long options without a letter; the player options come in X, O pairs
+enum { OPT_X_DEPTH = 256, OPT_O_DEPTH, OPT_X_TIME, OPT_O_TIME, OPT_X_NODES, OPT_O_NODES,
+       OPT_X_EVAL, OPT_O_EVAL, OPT_SPAWN_DEPTH, OPT_SPAWN_WORK, OPT_SPAWN_IDLE,
+       OPT_STATS, OPT_TRACE, OPT_MPI_DEPTH, OPT_PONDER };
+
+// Main
+int main(int argc, char **argv) {
+    const char *simd = "auto";
+    long checkgames = 0;
+    long hashmb = 64;
+    const char *cachefile = 0;
+    long cachemb = 256;
+    const char *evalfile = 0, *writeeval = 0;
+    long benchevals = 0;
+    const char *batchfile = 0;
+    int json = 0;
+    const char *workers = 0;
+    const char *statsfile = 0;
+    // all players, then each player (-1: not given)
+    Player all = { 0, 0, 0, 0, 0 };
+    char type[2] = { 0, 0 };
+    int depth[2] = { -1, -1 };
+    double seconds[2] = { -1, -1 };
+    long long nodes[2] = { -1, -1 };
+    const char *evalname[2] = { 0, 0 };
+    int perftdepth = 0;
+    const char *position = 0;
+    long ngames = 0;
+    const char *openingfile = 0;
+    int openingplies = 4;
+    const char *bookfile = 0, *buildbook = 0;
+    int bookplies = 6;
+
+#ifdef WITH_MPI
+    if (!MpiInit(&argc, &argv)) return 1;
+#endif
+    static struct option options[] = {
+        { "simd",       required_argument, 0, 's' },
+        { "check-simd", optional_argument, 0, 'k' },
+        { "hash",       required_argument, 0, 'H' },
+        { "cache",      required_argument, 0, 'C' },
+        { "cache-mb",   required_argument, 0, 'M' },
+        { "time",       required_argument, 0, 't' },
+        { "nodes",      required_argument, 0, 'n' },
+        { "order-depth", required_argument, 0, 'O' },
+        { "spawn-depth", required_argument, 0, OPT_SPAWN_DEPTH },
+        { "spawn-work", required_argument, 0, OPT_SPAWN_WORK },
+        { "spawn-idle", required_argument, 0, OPT_SPAWN_IDLE },
+        { "stats",      required_argument, 0, OPT_STATS },
+        { "trace",      required_argument, 0, OPT_TRACE },
+        { "mpi-depth",  required_argument, 0, OPT_MPI_DEPTH },
+        { "ponder",     no_argument,       0, OPT_PONDER },
+        { "endgame",    required_argument, 0, 'e' },
+        { "wld",        no_argument,       0, 'w' },
+        { "eval",       required_argument, 0, 'E' },
+        { "write-eval", required_argument, 0, 'W' },
+        { "bench-eval", optional_argument, 0, 'B' },
+        { "batch",      required_argument, 0, 'b' },
+        { "depth",      required_argument, 0, 'd' },
+        { "format",     required_argument, 0, 'f' },
+        { "perft",      required_argument, 0, 'p' },
+        { "position",   required_argument, 0, 'P' },
+        { "x",          required_argument, 0, 'x' },
+        { "o",          required_argument, 0, 'o' },
+        { "x-depth",    required_argument, 0, OPT_X_DEPTH },
+        { "o-depth",    required_argument, 0, OPT_O_DEPTH },
+        { "x-time",     required_argument, 0, OPT_X_TIME },
+        { "o-time",     required_argument, 0, OPT_O_TIME },
+        { "x-nodes",    required_argument, 0, OPT_X_NODES },
+        { "o-nodes",    required_argument, 0, OPT_O_NODES },
+        { "x-eval",     required_argument, 0, OPT_X_EVAL },
+        { "o-eval",     required_argument, 0, OPT_O_EVAL },
+        { "games",      required_argument, 0, 'g' },
+        { "openings",   required_argument, 0, 'i' },
+        { "opening-plies", required_argument, 0, 'l' },
+        { "book",       required_argument, 0, 'y' },
+        { "build-book", required_argument, 0, 'Y' },
+        { "book-plies", required_argument, 0, 'Z' },
+        { "workers",    required_argument, 0, 'j' },
+        { "quiet",      no_argument,       0, 'q' },
+        { "verbosity",  required_argument, 0, 'v' },
+        { "help",       no_argument,       0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, 0)) != -1) {
+        switch (opt) {
+        case 's': simd = optarg; break;
+        case 'k': checkgames = optarg ? atol(optarg) : 1000; break;
+        case 'H': hashmb = atol(optarg); break;
+        case 'C': cachefile = optarg; break;
+        case 'M': cachemb = atol(optarg); break;
+        case 't': all.seconds = atof(optarg); break;
+        case 'n': all.nodes = strtoull(optarg, 0, 10); break;
+        case 'O': order_search_depth = atoi(optarg); break;
+        case OPT_SPAWN_DEPTH: spawn_depth = atoi(optarg); break;
+        case OPT_SPAWN_WORK: spawn_work = atoi(optarg); break;
+        case OPT_SPAWN_IDLE: spawn_idle = atoi(optarg); break;
+        case OPT_STATS: statsfile = optarg; break;
+        case OPT_TRACE: trace_prefix = optarg; break;
+        case OPT_MPI_DEPTH: mpi_depth = atoi(optarg); break;
+        case OPT_PONDER: pondering = true; break;
+        case 'e': endgame_empties = atoi(optarg); break;
+        case 'w': endgame_wld = 1; break;
+        case 'E': evalfile = optarg; break;
+        case 'W': writeeval = optarg; break;
+        case 'B': benchevals = optarg ? atol(optarg) : 1000000; break;
+        case 'b': batchfile = optarg; break;
+        case 'p': perftdepth = atoi(optarg); break;
+        case 'P': position = optarg; break;
+        case 'd': all.depth = atoi(optarg); break;
+        case 'x':
+        case 'o':
+            if (strcmp(optarg, "h") && strcmp(optarg, "c")) {
+                Usage(argv[0]);
+                return 1;
+            }
+            type[opt == 'x' ? X_BLACK : O_WHITE] = optarg[0];
+            break;
+        case OPT_X_DEPTH: case OPT_O_DEPTH: depth[(opt - OPT_X_DEPTH) % 2] = atoi(optarg); break;
+        case OPT_X_TIME: case OPT_O_TIME: seconds[(opt - OPT_X_DEPTH) % 2] = atof(optarg); break;
+        case OPT_X_NODES: case OPT_O_NODES: nodes[(opt - OPT_X_DEPTH) % 2] = atoll(optarg); break;
+        case OPT_X_EVAL: case OPT_O_EVAL: evalname[(opt - OPT_X_DEPTH) % 2] = optarg; break;
+        case 'g': ngames = atol(optarg); break;
+        case 'i': openingfile = optarg; break;
+        case 'l': openingplies = atoi(optarg); break;
+        case 'y': bookfile = optarg; break;
+        case 'Y': buildbook = optarg; break;
+        case 'Z': bookplies = atoi(optarg); break;
+        case 'j': workers = optarg; break;
+        case 'q': verbosity = 0; break;
+        case 'v': verbosity = atoi(optarg); break;
+        case 'h': Usage(argv[0]); return 0;
+        case 'f':
+            if (strcmp(optarg, "csv") && strcmp(optarg, "json")) {
+                Usage(argv[0]);
+                return 1;
+            }
+            json = (strcmp(optarg, "json") == 0);
+            break;
+        default:  Usage(argv[0]); return 1;
+        }
+    }
+
+    if (workers && !ParSetWorkers(workers)) {
+        fprintf(stderr, "%s: cannot use %s workers\n", argv[0], workers);
+        return 1;
+    }
+    spawn_workers = ParWorkers();
+    if (statsfile && mpi_rank == 0) {
+#ifdef NO_STATS
+        fprintf(stderr, "%s: --stats: built without statistics (NO_STATS)\n", argv[0]);
+        return 1;
+#else
+        statsout = strcmp(statsfile, "-") ? fopen(statsfile, "w") : stdout;
+        if (!statsout) {
+            perror(statsfile);
+            return 1;
+        }
+#endif
+    }
+
+    InitRays();
+    if (!SelectKernels(simd)) {
+        fprintf(stderr, "%s: unknown or unsupported kernels '%s'\n", argv[0], simd);
+        return 1;
+    }
+    if (checkgames > 0 && mpi_rank == 0) {
+        return CheckKernels(checkgames) ? 1 : 0;
+    }
+    if (perftdepth > 0 && mpi_rank == 0) {
+        Board b = start;
+        int color = X_BLACK;
+        if (position && !ParsePosition(position, &b, &color)) {
+            fprintf(stderr, "%s: not a position: %s\n", argv[0], position);
+            return 1;
+        }
+        return RunPerft(b, color, perftdepth) ? 1 : 0;
+    }
+    InitPatterns(strcmp(simd, "scalar") != 0);
+    if (writeeval && mpi_rank == 0) {
+        return WriteEvalWeights(writeeval, SeedEvalWeights()) ? 0 : 1;
+    }
+    if (evalfile && !OpenEval(evalfile, &all.eval)) {
+        return 1;
+    }
+    if (benchevals > 0 && mpi_rank == 0) {
+        BenchEval(benchevals, all.eval ? all.eval : SeedEvalWeights());
+        return 0;
+    }
+    const EvalWeights *evals[2] = { all.eval, all.eval };
+    for (int c = X_BLACK; c <= O_WHITE; c++) {
+        if (evalname[c] && !OpenEval(evalname[c], &evals[c])) return 1;
+    }
+    InitZobrist();
+    if (!InitTT(hashmb)) {
+        fprintf(stderr, "%s: cannot allocate a %ld MB transposition table\n", argv[0], hashmb);
+        return 1;
+    }
+#ifdef WITH_MPI
+    // the ranks other than 0 only search root moves for it
+    mpi_evals[1] = all.eval;
+    mpi_evals[2] = evals[X_BLACK];
+    mpi_evals[3] = evals[O_WHITE];
+    if (mpi_rank > 0) return MpiServe();
+#endif
+    if (cachefile && !OpenCache(cachefile, cachemb)) {
+        return 1;
+    }
+    if (buildbook) {
+        Player analyst = all;
+        if (analyst.depth <= 0) analyst.depth = 12;
+        return BuildBook(buildbook, bookplies, &analyst) ? 0 : 1;
+    }
+    if (bookfile && !OpenBook(bookfile)) {
+        return 1;
+    }
+    if (batchfile) {
+        Player analyst = all;
+        if (analyst.depth <= 0) analyst.depth = 8;
+        return RunBatch(batchfile, &analyst, json, stdout) == 0 ? 0 : 1;
+    }
+
+    // players not set up on the command line are asked for on stdin
+    Player players[2];
+    for (int c = X_BLACK; c <= O_WHITE; c++) {
+        Player *p = &players[c];
+        *p = all;
+        if (type[c]) p->type = type[c];
+        if (depth[c] >= 0) p->depth = depth[c];
+        if (seconds[c] >= 0) p->seconds = seconds[c];
+        if (nodes[c] >= 0) p->nodes = nodes[c];
+        p->eval = evals[c];
+    }
+
+    if (ngames > 0) {
+        if (openingplies < 0 || openingplies > MAX_OPENING_PLIES) {
+            fprintf(stderr, "%s: --opening-plies must be 0..%d\n", argv[0], MAX_OPENING_PLIES);
+            return 1;
+        }
+        Opening *openings;
+        long nopenings = openingfile ? ReadOpenings(openingfile, &openings)
+                                     : MakeOpenings(openingplies, &openings);
+        if (nopenings <= 0) return 1;
+        for (int c = X_BLACK; c <= O_WHITE; c++) {
+            if (players[c].depth <= 0) players[c].depth = 8;
+        }
+        RunTournament(openings, nopenings, ngames, players);
+        free(openings);
+        return 0;
+    }
+
+    Board gameboard = start;
+    if (verbosity == 2) PrintBoard(gameboard);
+
+    for (int c = X_BLACK; c <= O_WHITE; c++) {
+        Player *p = &players[c];
+        if (!p->type) {
+            if (verbosity > 0) {
+                printf("Is Player %d (%c) [h]uman or [c]omputer? ", c + 1, c == X_BLACK ? 'X' : 'O');
+            }
+            scanf(" %c", &p->type);
+        }
+        if (p->type == 'c' && p->depth <= 0) {
+            if (verbosity > 0) printf("Enter search depth for %c (1..60): ", c == X_BLACK ? 'X' : 'O');
+            scanf("%d", &p->depth);
+        }
+    }
+
+    GameLog log;
+    PlayGame(&gameboard, X_BLACK, players, &log);
+
+    if (verbosity == 0) {
+        PrintSummary(gameboard, &log);
+        return 0;
+    }
     EndGame(gameboard);
     return 0;
 }
@@ -0,0 +1,201 @@
+/*
+	the parallel runtime the search runs on. othello.cpp spawns, syncs
+	and loops in parallel only through this interface:
+
+	    PAR_GROUP(g)          declare g, the tasks a node spawns
+	    PAR_SPAWN(g, call)    run call as a task of g; the arguments of
+	                          call must be plain values or pointers, since
+	                          some backends copy them into the task
+	    PAR_SYNC(g)           wait for the tasks of g
+	    ParallelFor(n, body)  body(i) for i in 0..n-1, in parallel
+	    ParallelRun(body)     body(), able to spawn: wraps the entries
+	                          into parallel code from serial code
+	    ParWorkerId()         the worker running the caller, 0..ParWorkers()-1
+	    ParWorkers()          the number of workers
+	    ParSetWorkers(n)      use n workers (a string, as on the command
+	                          line); 0 if the runtime will not
+
+	backends, chosen by defining one of:
+
+	    PAR_CILK      Intel Cilk Plus (icpc), cilk_spawn and cilk_for
+	    PAR_OPENCILK  OpenCilk (clang -fopencilk), likewise
+	    PAR_OPENMP    OpenMP tasks (-fopenmp)
+	    PAR_TBB       oneTBB task_group and parallel_for (-ltbb)
+	    PAR_SERIAL    no parallelism
+
+	or, if none is, OpenMP when compiled with it, else Cilk when
+	compiled with it, else serial.
+*/
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#if !defined(PAR_CILK) && !defined(PAR_OPENCILK) && !defined(PAR_OPENMP) && \
+    !defined(PAR_TBB) && !defined(PAR_SERIAL)
+#if defined(_OPENMP)
+#define PAR_OPENMP
+#elif defined(__cilk)
+#define PAR_CILK
+#else
+#define PAR_SERIAL
+#endif
+#endif
+
+#if defined(PAR_CILK) || defined(PAR_OPENCILK)
+
+#include <cstdlib>
+#include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
+
+#ifdef PAR_OPENCILK
+#define PAR_BACKEND_NAME "opencilk"
+#else
+#define PAR_BACKEND_NAME "cilk"
+#endif
+
+#define PAR_GROUP(g)
+#define PAR_SPAWN(g, call) cilk_spawn call
+#define PAR_SYNC(g) cilk_sync
+
+template <class F> static inline void ParallelFor(long n, const F &body) {
+    cilk_for (long i = 0; i < n; i++) body(i);
+}
+
+template <class F> static inline void ParallelRun(const F &body) {
+    body();
+}
+
+static inline int ParWorkerId(void) {
+    return __cilkrts_get_worker_number();
+}
+
+static inline int ParWorkers(void) {
+    return __cilkrts_get_nworkers();
+}
+
+static inline int ParSetWorkers(const char *n) {
+#ifdef PAR_OPENCILK
+    // OpenCilk has no __cilkrts_set_param; its runtime reads this when it starts
+    return atoi(n) > 0 && setenv("CILK_NWORKERS", n, 1) == 0;
+#else
+    return __cilkrts_set_param("nworkers", n) == 0;
+#endif
+}
+
+#elif defined(PAR_OPENMP)
+
+#include <cstdlib>
+#include <omp.h>
+
+#define PAR_BACKEND_NAME "openmp"
+
+// a task copies the values it names (firstprivate), so spawn with plain values
+#define PAR_GROUP(g)
+#define PAR_SPAWN(g, call) _Pragma("omp task") call
+#define PAR_SYNC(g) _Pragma("omp taskwait")
+
+// tasks need a team: outside of one, start it and run body on one thread
+template <class F> static inline void ParallelRun(const F &body) {
+    if (omp_get_level() > 0) {
+        body();
+        return;
+    }
+#pragma omp parallel
+#pragma omp single
+    body();
+}
+
+template <class F> static inline void ParallelFor(long n, const F &body) {
+    ParallelRun([&] {
+#pragma omp taskloop grainsize(1)
+        for (long i = 0; i < n; i++) body(i);
+    });
+}
+
+static inline int ParWorkerId(void) {
+    return omp_get_thread_num();
+}
+
+static inline int ParWorkers(void) {
+    return omp_get_max_threads();
+}
+
+static inline int ParSetWorkers(const char *n) {
+    int k = atoi(n);
+    if (k <= 0) return 0;
+    omp_set_num_threads(k);
+    return 1;
+}
+
+#elif defined(PAR_TBB)
+
+#include <cstdlib>
+#include <oneapi/tbb/global_control.h>
+#include <oneapi/tbb/parallel_for.h>
+#include <oneapi/tbb/task_arena.h>
+#include <oneapi/tbb/task_group.h>
+
+#define PAR_BACKEND_NAME "tbb"
+
+#define PAR_GROUP(g) tbb::task_group g
+#define PAR_SPAWN(g, call) g.run([=] { call; })
+#define PAR_SYNC(g) g.wait()
+
+template <class F> static inline void ParallelFor(long n, const F &body) {
+    tbb::parallel_for(0L, n, [&](long i) { body(i); });
+}
+
+template <class F> static inline void ParallelRun(const F &body) {
+    body();
+}
+
+static inline int ParWorkerId(void) {
+    return tbb::this_task_arena::current_thread_index();
+}
+
+static inline int ParWorkers(void) {
+    return (int) tbb::global_control::active_value(tbb::global_control::max_allowed_parallelism);
+}
+
+static inline int ParSetWorkers(const char *n) {
+    static tbb::global_control *limit = 0;
+    int k = atoi(n);
+    if (k <= 0) return 0;
+    delete limit;
+    limit = new tbb::global_control(tbb::global_control::max_allowed_parallelism, k);
+    return 1;
+}
+
+#else
+
+#define PAR_BACKEND_NAME "serial"
+
+#define PAR_GROUP(g)
+#define PAR_SPAWN(g, call) call
+#define PAR_SYNC(g) ((void) 0)
+
+template <class F> static inline void ParallelFor(long n, const F &body) {
+    for (long i = 0; i < n; i++) body(i);
+}
+
+template <class F> static inline void ParallelRun(const F &body) {
+    body();
+}
+
+static inline int ParWorkerId(void) {
+    return 0;
+}
+
+static inline int ParWorkers(void) {
+    return 1;
+}
+
+// any number is accepted and ignored, so scripts can run every backend alike
+static inline int ParSetWorkers(const char *n) {
+    (void) n;
+    return 1;
+}
+
+#endif
+
+#endif
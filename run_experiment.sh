@@ -17,7 +17,7 @@ for n in {1..32}; do
     export CILK_NWORKERS=$n
 
     # Run the program with the input file and capture time output
-    time_output=$( { time ./othello-parallel < default_input; } 2>&1 )
+    time_output=$( { time ./othello-parallel --quiet < default_input; } 2>&1 )
 
     # Extract real, user, and sys times from the time output
     real_time=$(echo "$time_output" | grep "^real" | awk '{print $2}')
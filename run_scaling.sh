@@ -0,0 +1,64 @@
+#!/bin/bash
+# run_scaling.sh
+# This script runs every parallel runtime build of othello that has been made
+# (othello for Cilk Plus, othello-opencilk, othello-openmp, othello-tbb) on the
+# same positions with --batch, for a list of worker counts, and writes the
+# times to a CSV file next to those of the serial build (othello-serial).
+#
+# usage: ./run_scaling.sh ["worker counts"] [depth] [positions file]
+# defaults: "1 2 4 8 16", depth 8, batch_input
+#
+# Speedup is the backend's time on the first worker count (1 by default) over
+# its time on n workers. Overhead is that first time over the serial build's
+# time: with 1 worker first, what spawning and syncing cost with no one to
+# steal.
+
+workers=${1:-1 2 4 8 16}
+depth=${2:-8}
+positions=${3:-batch_input}
+
+# Output file to store the results
+output_file="scaling_times.csv"
+
+# the seconds of real, user and system time of one run
+run() {
+    local TIMEFORMAT="%R %U %S"
+    { time "$@" > /dev/null; } 2>&1
+}
+
+if [ ! -x ./othello-serial ]; then
+    echo "build othello-serial first (make othello-serial)"
+    exit 1
+fi
+
+serial=$(run ./othello-serial --batch="$positions" --depth="$depth")
+serial_time=$(echo "$serial" | awk '{print $1}')
+
+# Write the header and the serial time to the output file
+echo "Backend,Threads,Real Time,User Time,System Time,Speedup,Overhead" > "$output_file"
+echo "serial,1,$(echo "$serial" | tr ' ' ','),1.00,1.00" >> "$output_file"
+echo "Serial: $serial_time s"
+
+for backend in othello othello-opencilk othello-openmp othello-tbb; do
+    if [ ! -x ./$backend ]; then
+        echo "Skipping $backend, not built"
+        continue
+    fi
+    one=""
+    for n in $workers; do
+        times=$(run ./$backend --workers=$n --batch="$positions" --depth="$depth")
+        real_time=$(echo "$times" | awk '{print $1}')
+        if [ -z "$one" ]; then
+            one=$real_time
+        fi
+        speedup=$(awk -v a="$one" -v b="$real_time" 'BEGIN { printf "%.2f", a / b }')
+        overhead=$(awk -v a="$one" -v b="$serial_time" 'BEGIN { printf "%.2f", a / b }')
+
+        # Append the results to the CSV output file
+        echo "$backend,$n,$(echo "$times" | tr ' ' ','),$speedup,$overhead" >> "$output_file"
+
+        echo "$backend: $n workers, Real: $real_time s, Speedup: $speedup, Overhead: $overhead"
+    done
+done
+
+echo "Execution times saved to $output_file"